@@ -0,0 +1,246 @@
+#include "raylib.h"
+#include "game.h"
+#include "bot.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+// Plays many independent headless matches across all cores and writes one
+// CSV row per match, for answering balance questions with numbers instead
+// of playtests. Matches share nothing but the immutable maps and weapon
+// table, and each one is seeded from the run's seed by its index, so the
+// rows do not depend on how many threads ran them.
+//
+//   batchsim [--matches N] [--threads N] [--players N] [--seed S]
+//            [--map FILE]... [--weapons FILE] [--spread-scale X] [--fuse S]
+//            [--max-ticks N] [--bots] [-o OUT.csv]
+//
+// Players follow the scripted input pattern unless --bots hands them all to
+// bots, which go for guns and fight.
+
+struct BatchOptions {
+  int matches = 1000;
+  int threads = 0;
+  int players = 2;
+  uint64_t seed = 1;
+  std::vector<std::string> mapFiles;
+  std::string weaponsFile = WEAPONS_FILE;
+  float spreadScale = 1.0f;
+  float fuse = -1.0f;
+  // A match still running after this many ticks is cut off and has no winner.
+  long long maxTicks = 20 * 60 * (long long)DEFAULT_TICK_RATE;
+  bool bots = false;
+  std::string outPath;
+};
+
+struct MatchStats {
+  uint64_t seed = 0;
+  long long ticks = 0;
+  bool timedOut = false;
+  // -1 when the match timed out or ended with a shared lead.
+  int winner = -1;
+  // Winner of each round played, -1 when nobody survived it.
+  std::vector<int> roundWinners;
+  std::vector<int> wins;
+  std::vector<int> kills;
+  std::vector<int> deaths;
+  // Seconds from the start of a round to each death in it.
+  double ttkTotal = 0.0;
+  int ttkCount = 0;
+};
+
+// The table from the weapon file with the command line overrides applied.
+WeaponsRef batchWeapons(BatchOptions const &opt) {
+  WeaponTable table = *loadWeapons(opt.weaponsFile);
+  for (GunArchetype &gun : table.guns) gun.spread *= opt.spreadScale;
+  if (opt.fuse >= 0.0f) table.grenade.fuse = opt.fuse;
+  return std::make_shared<WeaponTable const>(table);
+}
+
+void runMatch(World &world, std::vector<Bot> &bots, BatchOptions const &opt,
+              WeaponsRef const &weapons, uint64_t seed, MatchStats &stats) {
+  float const dt = 1.0f / DEFAULT_TICK_RATE;
+  world.weapons = weapons;
+  initWorld(world, opt.players, seed, opt.mapFiles);
+  bots.clear();
+  if (opt.bots) initBots(bots, world, seed);
+
+  int players = opt.players;
+  stats.seed = seed;
+  stats.roundWinners.clear();
+  stats.kills.assign(players, 0);
+  stats.deaths.assign(players, 0);
+  // Shifts the scripted pattern per match so players do not repeat the
+  // same moves at the same time in every match.
+  uint64_t phase = seed % 997;
+
+  std::vector<bool> alive(players);
+  std::vector<int> winsBefore(players);
+  long long roundStart = 0;
+  long long tick = 0;
+  for (; tick < opt.maxTicks && world.match.state != MATCH_OVER; tick++) {
+    MatchInfo const &match = world.match;
+    GameState state = match.state;
+    for (int i = 0; i < players; i++) {
+      alive[i] = hasFlag(world.players[i].status_flags, ALIVE);
+      if (!opt.bots) feedControls(world.players[i].controls, scriptedInput(i, (uint64_t)tick + phase));
+    }
+    feedBots(bots, world);
+    std::copy(match.wins.begin(), match.wins.end(), winsBefore.begin());
+
+    stepWorld(world, dt);
+
+    if (state != ROUND_ACTIVE) {
+      if (match.state == ROUND_ACTIVE) roundStart = tick + 1;
+      continue;
+    }
+    for (int i = 0; i < players; i++) {
+      if (!alive[i] || hasFlag(world.players[i].status_flags, ALIVE)) continue;
+      stats.deaths[i]++;
+      stats.ttkTotal += (tick + 1 - roundStart) * (double)dt;
+      stats.ttkCount++;
+    }
+    if (match.state == ROUND_OVER) {
+      int winner = -1;
+      for (int i = 0; i < players; i++) {
+        if (match.wins[i] != winsBefore[i]) winner = i;
+      }
+      stats.roundWinners.push_back(winner);
+    }
+  }
+
+  MatchInfo const &match = world.match;
+  stats.ticks = tick;
+  stats.timedOut = match.state != MATCH_OVER;
+  stats.wins = match.wins;
+  stats.winner = stats.timedOut ? -1 : matchWinner(match);
+  for (int i = 0; i < players; i++) stats.kills[i] = world.players[i].kills;
+}
+
+void writeCsv(FILE *out, BatchOptions const &opt, std::vector<MatchStats> const &results) {
+  fprintf(out, "match,seed,ticks,seconds,timed_out,winner,rounds,round_winners,mean_ttk_s");
+  for (int i = 0; i < opt.players; i++) fprintf(out, ",p%d_wins,p%d_kills,p%d_deaths", i, i, i);
+  fprintf(out, "\n");
+  for (size_t m = 0; m < results.size(); m++) {
+    MatchStats const &s = results[m];
+    fprintf(out, "%zu,%llu,%lld,%.3f,%d,%d,%zu,", m, (unsigned long long)s.seed, s.ticks,
+            s.ticks / (double)DEFAULT_TICK_RATE, s.timedOut ? 1 : 0, s.winner, s.roundWinners.size());
+    for (size_t r = 0; r < s.roundWinners.size(); r++) {
+      fprintf(out, "%s%d", r ? " " : "", s.roundWinners[r]);
+    }
+    fprintf(out, ",%.3f", s.ttkCount ? s.ttkTotal / s.ttkCount : 0.0);
+    for (int i = 0; i < opt.players; i++) {
+      fprintf(out, ",%d,%d,%d", s.wins[i], s.kills[i], s.deaths[i]);
+    }
+    fprintf(out, "\n");
+  }
+}
+
+void printSummary(BatchOptions const &opt, std::vector<MatchStats> const &results, double seconds) {
+  std::vector<int> matchWins(opt.players, 0);
+  int timedOut = 0;
+  int drawn = 0;
+  long long ticks = 0;
+  double ttkTotal = 0.0;
+  int ttkCount = 0;
+  for (MatchStats const &s : results) {
+    if (s.timedOut) timedOut++;
+    else if (s.winner >= 0) matchWins[s.winner]++;
+    else drawn++;
+    ticks += s.ticks;
+    ttkTotal += s.ttkTotal;
+    ttkCount += s.ttkCount;
+  }
+  double rate = results.size() / seconds;
+  fprintf(stderr, "%zu matches in %.2f s on %d threads: %.1f matches/s, %.1f per thread, "
+          "%.2f Mticks/s\n", results.size(), seconds, opt.threads, rate, rate / opt.threads,
+          ticks / seconds / 1e6);
+  fprintf(stderr, "mean time to kill %.2f s, %d timed out, %d drawn\n",
+          ttkCount ? ttkTotal / ttkCount : 0.0, timedOut, drawn);
+  for (int i = 0; i < opt.players; i++) {
+    fprintf(stderr, "  player %d won %.1f%%\n", i, 100.0 * matchWins[i] / results.size());
+  }
+}
+
+int main(int argc, char **argv) {
+  BatchOptions opt;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--matches") && i + 1 < argc) {
+      opt.matches = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      opt.threads = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--players") && i + 1 < argc) {
+      opt.players = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      opt.seed = strtoull(argv[++i], nullptr, 10);
+    } else if (!strcmp(argv[i], "--map") && i + 1 < argc) {
+      opt.mapFiles.push_back(argv[++i]);
+    } else if (!strcmp(argv[i], "--weapons") && i + 1 < argc) {
+      opt.weaponsFile = argv[++i];
+    } else if (!strcmp(argv[i], "--spread-scale") && i + 1 < argc) {
+      opt.spreadScale = (float)atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--fuse") && i + 1 < argc) {
+      opt.fuse = (float)atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--max-ticks") && i + 1 < argc) {
+      opt.maxTicks = atoll(argv[++i]);
+    } else if (!strcmp(argv[i], "--bots")) {
+      opt.bots = true;
+    } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+      opt.outPath = argv[++i];
+    } else {
+      fprintf(stderr, "usage: %s [--matches N] [--threads N] [--players N] [--seed S]\n"
+                      "       [--map FILE]... [--weapons FILE] [--spread-scale X] [--fuse S]\n"
+                      "       [--max-ticks N] [--bots] [-o OUT.csv]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (opt.matches <= 0 || opt.players < 2 || opt.players > MAX_PLAYERS ||
+      opt.maxTicks <= 0 || opt.spreadScale < 0.0f) {
+    fprintf(stderr, "matches and max ticks must be positive, players between 2 and %d\n",
+            MAX_PLAYERS);
+    return 1;
+  }
+  if (opt.threads <= 0) opt.threads = std::max(1u, std::thread::hardware_concurrency());
+  opt.threads = std::min(opt.threads, opt.matches);
+  if (opt.mapFiles.empty()) opt.mapFiles = defaultMapFiles();
+
+  SetTraceLogLevel(LOG_WARNING);
+  WeaponsRef weapons = batchWeapons(opt);
+  // Load every map up front so no match waits on another one's load.
+  for (std::string const &path : opt.mapFiles) acquireMap(path);
+
+  std::vector<uint64_t> seeds(opt.matches);
+  Rng rng;
+  seedRng(rng, opt.seed);
+  for (uint64_t &seed : seeds) seed = ((uint64_t)nextRandom(rng) << 32) | nextRandom(rng);
+
+  std::vector<MatchStats> results(opt.matches);
+  std::atomic<int> next{0};
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < opt.threads; t++) {
+    threads.emplace_back([&]() {
+      // Worlds are large; each thread reuses one for all of its matches.
+      std::unique_ptr<World> world(new World());
+      std::vector<Bot> bots;
+      for (int m; (m = next.fetch_add(1)) < opt.matches;) {
+        runMatch(*world, bots, opt, weapons, seeds[m], results[m]);
+      }
+    });
+  }
+  for (std::thread &thread : threads) thread.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  FILE *out = stdout;
+  if (!opt.outPath.empty() && !(out = fopen(opt.outPath.c_str(), "w"))) {
+    fprintf(stderr, "cannot write %s\n", opt.outPath.c_str());
+    return 1;
+  }
+  writeCsv(out, opt, results);
+  if (out != stdout) fclose(out);
+  printSummary(opt, results, seconds);
+  return 0;
+}
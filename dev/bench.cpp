@@ -0,0 +1,193 @@
+#include "raylib.h"
+#include "game.h"
+#include "bot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Runs fixed scenarios through stepWorld and prints per-tick timings as
+// JSON, so runs from two commits can be diffed. Every scenario is seeded
+// and scripted, so the checksum at the end only changes when the
+// simulation does.
+//
+//   bench [--ticks N] [--only NAME]
+
+// Heap allocations made on this thread; map preloads on worker threads are
+// not part of any tick.
+static thread_local size_t heapAllocations = 0;
+
+void *operator new(size_t size) {
+  heapAllocations++;
+  void *p = malloc(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+struct Scenario {
+  const char *name;
+  int players;
+  std::vector<std::string> maps;
+  // Called before every tick, after input was fed; may poke at the world to
+  // keep the scenario in the state it measures.
+  void (*prepare)(World &world, long long tick);
+  // Null when every player is a bot.
+  uint16_t (*input)(int playerId, uint64_t tick);
+};
+
+uint16_t noInput(int, uint64_t) {
+  return 0;
+}
+
+// Runs right, jumping, so the players cross the map.
+uint16_t traverseInput(int, uint64_t tick) {
+  uint16_t held = ACTION_RIGHT;
+  if (tick % 60 < 12) held |= ACTION_JUMP;
+  if (tick % 240 == 0) held |= ACTION_DASH;
+  return held;
+}
+
+// Throws a grenade every other tick.
+uint16_t grenadeInput(int playerId, uint64_t tick) {
+  return (((tick + playerId) & 1) ? ACTION_GRENADE : 0) | scriptedInput(playerId, tick);
+}
+
+void keepGrenades(World &world, long long) {
+  for (Player &pl : world.players) pl.grenadeCount = 3;
+}
+
+// Ends a round a few ticks after it starts and skips the round-over wait,
+// so most ticks are spent tearing down and setting up rounds.
+void churnRounds(World &world, long long tick) {
+  MatchInfo &match = world.match;
+  if (match.state == ROUND_ACTIVE && tick % 8 == 0) {
+    for (size_t i = 1; i < world.players.size(); i++) {
+      clearFlag(world.players[i].status_flags, ALIVE);
+    }
+  } else if (match.state == ROUND_OVER) {
+    match.roundOverTimer = 0.0f;
+  }
+}
+
+std::vector<Scenario> scenarios() {
+  return {
+    {"idle_2p", 2, defaultMapFiles(), nullptr, noInput},
+    {"firefight_16p", 16, {"generate:96x48:7"}, nullptr, scriptedInput},
+    {"grenade_spam_8p", 8, defaultMapFiles(), keepGrenades, grenadeInput},
+    {"large_map_traversal", 2, {"generate:4096x4096:1"}, nullptr, traverseInput},
+    {"round_churn", 2, defaultMapFiles(), churnRounds, scriptedInput},
+    {"bots_16p", 16, {"generate:96x48:7"}, nullptr, nullptr},
+  };
+}
+
+struct Result {
+  long long ticks = 0;
+  // Rounds started while measuring, including ones that start a match.
+  int rounds = 0;
+  double meanNs = 0.0;
+  double p50Ns = 0.0;
+  double p99Ns = 0.0;
+  double maxNs = 0.0;
+  double allocationsPerTick = 0.0;
+  // Time the bots took to pick their inputs, per bot per tick.
+  double botNs = 0.0;
+  uint64_t checksum = 0;
+};
+
+// Ticks before measuring starts, so the first map loads and pool warm-up
+// stay out of the numbers.
+int const WARMUP_TICKS = 240;
+
+Result runScenario(Scenario const &scenario, long long ticks) {
+  float const dt = 1.0f / DEFAULT_TICK_RATE;
+  World world;
+  initWorld(world, scenario.players, 1, scenario.maps);
+  std::vector<Bot> bots;
+  if (!scenario.input) initBots(bots, world, 1);
+  double botNs = 0.0;
+
+  std::vector<double> times;
+  times.reserve(ticks);
+  size_t allocations = 0;
+  int rounds = 0;
+  for (long long tick = -WARMUP_TICKS; tick < ticks; tick++) {
+    if (scenario.input) {
+      for (Player &player : world.players) {
+        feedControls(player.controls, scenario.input(player.id, (uint64_t)(tick + WARMUP_TICKS)));
+      }
+    } else {
+      auto botStart = std::chrono::steady_clock::now();
+      feedBots(bots, world);
+      auto botEnd = std::chrono::steady_clock::now();
+      if (tick >= 0) botNs += std::chrono::duration<double, std::nano>(botEnd - botStart).count();
+    }
+    if (scenario.prepare) scenario.prepare(world, tick);
+
+    int round = world.match.currentRound;
+    size_t allocationsBefore = heapAllocations;
+    auto start = std::chrono::steady_clock::now();
+    stepWorld(world, dt);
+    auto end = std::chrono::steady_clock::now();
+    if (tick >= 0) {
+      times.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+      allocations += heapAllocations - allocationsBefore;
+    }
+    if (world.match.state == MATCH_OVER) restartMatch(world);
+    if (tick >= 0 && world.match.currentRound != round) rounds++;
+  }
+
+  Result r;
+  r.rounds = rounds;
+  r.ticks = ticks;
+  for (double t : times) r.meanNs += t;
+  r.meanNs /= (double)times.size();
+  r.allocationsPerTick = allocations / (double)times.size();
+  r.botNs = bots.empty() ? 0.0 : botNs / ((double)times.size() * bots.size());
+  r.checksum = worldChecksum(world);
+  std::sort(times.begin(), times.end());
+  r.p50Ns = times[times.size() / 2];
+  r.p99Ns = times[std::min(times.size() - 1, times.size() * 99 / 100)];
+  r.maxNs = times.back();
+  return r;
+}
+
+int main(int argc, char **argv) {
+  long long ticks = 20000;
+  const char *only = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--ticks") && i + 1 < argc) {
+      ticks = atoll(argv[++i]);
+    } else if (!strcmp(argv[i], "--only") && i + 1 < argc) {
+      only = argv[++i];
+    } else {
+      fprintf(stderr, "usage: %s [--ticks N] [--only NAME]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (ticks <= 0) {
+    fprintf(stderr, "ticks must be positive\n");
+    return 1;
+  }
+
+  SetTraceLogLevel(LOG_WARNING);
+
+  printf("{\n  \"ticks\": %lld,\n  \"scenarios\": [", ticks);
+  bool first = true;
+  for (Scenario const &scenario : scenarios()) {
+    if (only && strcmp(only, scenario.name)) continue;
+    Result r = runScenario(scenario, ticks);
+    printf("%s\n    {\"name\": \"%s\", \"players\": %d, \"rounds\": %d, \"ns_per_tick\": %.1f, "
+           "\"p50_ns\": %.1f, \"p99_ns\": %.1f, \"max_ns\": %.1f, "
+           "\"allocs_per_tick\": %.4f, \"bot_ns\": %.1f, \"checksum\": \"%016llx\"}",
+           first ? "" : ",", scenario.name, scenario.players, r.rounds, r.meanNs, r.p50Ns, r.p99Ns,
+           r.maxNs, r.allocationsPerTick, r.botNs, (unsigned long long)r.checksum);
+    fflush(stdout);
+    first = false;
+  }
+  printf("\n  ]\n}\n");
+  return 0;
+}
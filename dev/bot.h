@@ -0,0 +1,305 @@
+#pragma once
+
+#include "game.h"
+
+// Computer players. A bot reads the World the same way a person reads the
+// screen and answers with an action mask, which is fed into the player's
+// Controls like any other input source, so the simulation, replays and the
+// checksum cannot tell a bot from a keyboard.
+//
+// Navigation is reactive and only looks at the tiles next to the player:
+// walk toward the goal, jump walls and gaps, refuse ledges with nothing
+// below, jump when pressed against something, and wander off to one side
+// when the goal gets no closer. Goals are re-picked every
+// BOT_RETARGET_TICKS: an unclaimed gun while unarmed, otherwise the
+// nearest living opponent, with grenade pickups picked up on the way when
+// short of grenades. That keeps a bot to a handful of tile lookups per
+// tick plus a scan of the item pools now and then.
+
+int const BOT_RETARGET_TICKS = 15;
+// Ticks without moving before a bot tries to jump out.
+int const BOT_STUCK_TICKS = 20;
+// Ticks without getting closer to its goal before a bot wanders off to one
+// side for BOT_DETOUR_TICKS, to find another way up or down. Items it
+// could not reach are then skipped.
+int const BOT_GIVE_UP_TICKS = 180;
+int const BOT_DETOUR_TICKS = 120;
+int const BOT_GRENADE_COOLDOWN_TICKS = 180;
+// Horizontal distance a bot keeps from the opponent it is shooting at.
+float const BOT_STANDOFF = 220.0f;
+// Horizontal distances a thrown grenade lands in.
+float const BOT_GRENADE_MIN_RANGE = 150.0f;
+float const BOT_GRENADE_MAX_RANGE = 450.0f;
+
+struct Bot {
+    int playerId = 0;
+    Rng rng;
+    Vector2 goal = {0, 0};
+    // Player being chased, or -1 when heading for an item or wandering.
+    int target = -1;
+    int retargetIn = 0;
+    // Closest the bot has been to its goal, and ticks since it got closer.
+    float closest = FLT_MAX;
+    int sinceCloser = 0;
+    // Item given up on, skipped when picking goals.
+    Vector2 ignore = {-FLT_MAX, -FLT_MAX};
+    int stuckTicks = 0;
+    int detourTicks = 0;
+    int detourDir = 1;
+    int grenadeCooldown = 0;
+    float lastX = 0.0f;
+    uint16_t held = 0;
+};
+
+void initBot(Bot &bot, int playerId, uint64_t seed) {
+    bot = Bot();
+    bot.playerId = playerId;
+    seedRng(bot.rng, seed * 31 + (uint64_t)playerId + 1);
+    bot.retargetIn = randomRange(bot.rng, 0, BOT_RETARGET_TICKS - 1);
+}
+
+// Hands every player from `first` on to a bot.
+void initBots(std::vector<Bot> &bots, World &world, uint64_t seed, int first = 0) {
+    bots.clear();
+    for (int i = first; i < (int)world.players.size(); i++) {
+        bots.emplace_back();
+        initBot(bots.back(), i, seed);
+        world.players[i].controls.deviceId = CONTROLS_BOT;
+    }
+}
+
+Vector2 playerCenter(Player const &pl) {
+    return {pl.x + pl.w * 0.5f, pl.y + pl.h * 0.5f};
+}
+
+// Rows above the floor a bot can still grab an item from; a jump clears
+// about four tiles.
+int const BOT_REACH_ROWS = 4;
+
+// Items float where they spawned, so only those with a floor close enough
+// below them are worth going for.
+bool botCanReach(GameMap const &map, Vector2 spot) {
+    int col = (int)floorf(spot.x / TILE_SIZE);
+    int row = (int)floorf(spot.y / TILE_SIZE);
+    if (col < 0 || col >= map.width || row < 0 || isSolid(map, col, row)) return false;
+    for (int bottom = std::min(map.height, row + BOT_REACH_ROWS + 1); ++row < bottom;) {
+        if (isSolid(map, col, row)) return true;
+    }
+    return false;
+}
+
+// Rough travel cost, with climbing weighted up since it needs platforms.
+float botDistance(Vector2 from, Vector2 to) {
+    return fabsf(to.x - from.x) + 2.0f * fabsf(to.y - from.y);
+}
+
+bool botIgnores(Bot const &bot, Vector2 spot) {
+    return fabsf(spot.x - bot.ignore.x) < TILE_SIZE && fabsf(spot.y - bot.ignore.y) < TILE_SIZE;
+}
+
+void pickBotGoal(Bot &bot, World const &world) {
+    Player const &self = world.players[bot.playerId];
+    GameMap const &map = *world.map;
+    Vector2 at = playerCenter(self);
+    Vector2 previous = bot.goal;
+    float best = FLT_MAX;
+    bot.target = -1;
+
+    if (isNull(self.gun)) {
+        forEachItem(world.guns, [&](Gun const &gun, Handle) {
+            if (gun.picked_up) return;
+            GunArchetype const &kind = gunArchetype(*world.weapons, gun);
+            Vector2 spot = {gun.x + kind.w * 0.5f, gun.y + kind.h * 0.5f};
+            if (!botCanReach(map, spot) || botIgnores(bot, spot)) return;
+            float d = botDistance(at, spot);
+            if (d < best) {
+                best = d;
+                bot.goal = spot;
+            }
+        });
+    }
+    // Without a gun or grenades there is nothing to fight with, so wander
+    // until a gun turns up.
+    if (best == FLT_MAX && (!isNull(self.gun) || self.grenadeCount > 0)) {
+        for (Player const &pl : world.players) {
+            if (pl.id == self.id || !hasFlag(pl.status_flags, ALIVE)) continue;
+            float d = botDistance(at, playerCenter(pl));
+            if (d < best) {
+                best = d;
+                bot.goal = playerCenter(pl);
+                bot.target = pl.id;
+            }
+        }
+    }
+    // A grenade pickup wins when it is not much of a detour.
+    if (self.grenadeCount < self.maxGrenades) {
+        forEachItem(world.pickups, [&](Pickup const &p, Handle) {
+            if (!p.active || p.type != GRENADE || !botCanReach(map, p.position) ||
+                botIgnores(bot, p.position)) {
+                return;
+            }
+            float d = botDistance(at, p.position);
+            if (d < best * 0.5f) {
+                best = d;
+                bot.goal = p.position;
+                bot.target = -1;
+            }
+        });
+    }
+    if (best == FLT_MAX) {
+        float x = at.x + (randomFloat(bot.rng) < 0.5f ? -1.0f : 1.0f) * 10 * TILE_SIZE;
+        bot.goal = {std::clamp(x, (float)TILE_SIZE, (float)(map.width - 1) * TILE_SIZE), at.y};
+    }
+    if (botDistance(previous, bot.goal) > TILE_SIZE) {
+        bot.closest = FLT_MAX;
+        bot.sinceCloser = 0;
+    }
+}
+
+// Deepest drop, in tiles, a bot will walk off a ledge into.
+int const BOT_MAX_DROP = 12;
+
+// Whether anything solid is below tile column x within BOT_MAX_DROP rows
+// of row y.
+bool hasGroundBelow(GameMap const &map, int x, int y) {
+    for (int bottom = std::min(map.height, y + BOT_MAX_DROP); y < bottom; y++) {
+        if (isSolid(map, x, y)) return true;
+    }
+    return false;
+}
+
+// Action mask for this tick. Only reads the world, so bots can run in any
+// order before the step they feed.
+uint16_t botInput(Bot &bot, World const &world) {
+    Player const &self = world.players[bot.playerId];
+    uint16_t held = 0;
+    if (!hasFlag(self.status_flags, ALIVE) || world.match.state != ROUND_ACTIVE) {
+        bot.held = 0;
+        return 0;
+    }
+    GameMap const &map = *world.map;
+
+    if (bot.target >= 0) {
+        Player const &target = world.players[bot.target];
+        if (hasFlag(target.status_flags, ALIVE)) bot.goal = playerCenter(target);
+        else bot.retargetIn = 0;
+    }
+    if (--bot.retargetIn <= 0) {
+        pickBotGoal(bot, world);
+        bot.retargetIn = BOT_RETARGET_TICKS;
+    }
+
+    Vector2 at = playerCenter(self);
+    float dx = bot.goal.x - at.x;
+    float dy = bot.goal.y - at.y;
+    int dir = dx > 8.0f ? 1 : (dx < -8.0f ? -1 : 0);
+
+    bool fighting = false;
+    if (bot.target >= 0 && fabsf(dy) < self.h) {
+        Gun const *gun = getItem(world.guns, self.gun);
+        float range = gun ? gunArchetype(*world.weapons, *gun).range : 0.0f;
+        if (gun && fabsf(dx) < range * 0.9f) {
+            fighting = true;
+            held |= ACTION_FIRE;
+            // Turn to face the target, then hold still for a steadier aim.
+            if (self.facing == dir && fabsf(dx) < BOT_STANDOFF) dir = 0;
+        } else if (!gun && fabsf(dx) < BOT_GRENADE_MIN_RANGE) {
+            // Back off to where a grenade lands on the target.
+            dir = dx > 0.0f ? -1 : 1;
+        }
+        if (bot.grenadeCooldown <= 0 && self.grenadeCount > 0 && self.facing == (dx > 0 ? 1 : -1) &&
+            fabsf(dx) > BOT_GRENADE_MIN_RANGE && fabsf(dx) < BOT_GRENADE_MAX_RANGE) {
+            held |= ACTION_GRENADE;
+            bot.grenadeCooldown = BOT_GRENADE_COOLDOWN_TICKS + randomRange(bot.rng, 0, 60);
+        }
+    }
+    if (bot.grenadeCooldown > 0) bot.grenadeCooldown--;
+
+    if (bot.detourTicks > 0) {
+        bot.detourTicks--;
+        dir = bot.detourDir;
+    }
+    // Steer back over the map after being knocked or jumping past its edge.
+    if (at.x < 0.0f) dir = 1;
+    if (at.x > map.width * TILE_SIZE) dir = -1;
+
+    bool grounded = hasFlag(self.status_flags, GROUNDED);
+    if (dir != 0 && grounded) {
+        int feetRow = (int)floorf((self.y + self.h + 1.0f) / TILE_SIZE);
+        int frontCol = (int)floorf((dir > 0 ? self.x + self.w + 4.0f : self.x - 4.0f) / TILE_SIZE);
+        int headRow = (int)floorf(self.y / TILE_SIZE);
+        bool wall = false;
+        for (int row = headRow; row < feetRow && !wall; row++) {
+            wall = isSolid(map, frontCol, row);
+        }
+        bool ledge = !isSolid(map, frontCol, feetRow);
+        if (wall) {
+            held |= ACTION_JUMP;
+        } else if (ledge) {
+            // Take the drop when it lands somewhere and the goal is below;
+            // otherwise jump for ground ahead, or turn back from a fall
+            // too deep to see the bottom of.
+            bool landing = false;
+            for (int col = frontCol + dir; col != frontCol + dir * 5 && !landing; col += dir) {
+                for (int row = feetRow - 2; row <= feetRow + 1 && !landing; row++) {
+                    landing = isSolid(map, col, row);
+                }
+            }
+            bool drop = hasGroundBelow(map, frontCol, feetRow);
+            if (!(drop && dy > TILE_SIZE)) {
+                if (landing) held |= ACTION_JUMP;
+                else if (!drop) dir = 0;
+            }
+        }
+    }
+    if (grounded && dy < -TILE_SIZE && fabsf(dx) < 3 * TILE_SIZE) {
+        // The goal is overhead; jump for it.
+        held |= ACTION_JUMP;
+    }
+    if (!grounded && self.dy < 0.0f && (bot.held & ACTION_JUMP)) {
+        held |= ACTION_JUMP;
+    }
+
+    // Pressed against something: jump.
+    if (dir != 0 && !fighting && fabsf(self.x - bot.lastX) < 0.5f) {
+        if (++bot.stuckTicks > BOT_STUCK_TICKS) held |= ACTION_JUMP;
+    } else {
+        bot.stuckTicks = 0;
+    }
+    bot.lastX = self.x;
+
+    // Not getting any closer, typically to a goal on a platform straight
+    // above or below: try going round.
+    float distance = botDistance(at, bot.goal);
+    if (distance < bot.closest - 4.0f || fighting) {
+        bot.closest = distance;
+        bot.sinceCloser = 0;
+    } else if (++bot.sinceCloser > BOT_GIVE_UP_TICKS) {
+        if (bot.target < 0) bot.ignore = bot.goal;
+        bot.closest = FLT_MAX;
+        bot.sinceCloser = 0;
+        bot.detourDir = randomFloat(bot.rng) < 0.5f ? -1 : 1;
+        bot.detourTicks = BOT_DETOUR_TICKS;
+        bot.retargetIn = BOT_DETOUR_TICKS;
+    }
+
+    if (dir > 0) held |= ACTION_RIGHT;
+    if (dir < 0) held |= ACTION_LEFT;
+    // Edge-triggered actions have to be let go of before they fire again.
+    if (self.canInteract && isNull(self.gun) && !(bot.held & ACTION_INTERACT)) {
+        held |= ACTION_INTERACT;
+    }
+    if (bot.held & ACTION_GRENADE) held &= ~ACTION_GRENADE;
+
+    bot.held = held;
+    return held;
+}
+
+// Feeds every bot-controlled player its input for the next step.
+void feedBots(std::vector<Bot> &bots, World &world) {
+    for (Bot &bot : bots) {
+        Controls &controls = world.players[bot.playerId].controls;
+        if (controls.deviceId != CONTROLS_BOT) continue;
+        feedControls(controls, botInput(bot, world));
+    }
+}
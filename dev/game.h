@@ -0,0 +1,2741 @@
+#pragma once
+
+#include "raylib.h"
+#include "raymath.h"
+#include "profiler.h"
+#include "stdio.h"
+#include "float.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cmath>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int const RES_W = 1920;
+int const RES_H = 1080;
+
+enum Tile {
+  VOID,
+  TILE,
+};
+
+int const TILE_SIZE = 64;
+
+// Large maps are streamed and simulated in square chunks of this many tiles.
+int const MAP_CHUNK_TILES = 32;
+
+// Bump allocator for state that lives exactly one round. Allocating moves a
+// pointer inside a block, freeing does nothing, and resetArena takes
+// everything back at once when the next round starts. Blocks are kept across
+// resets, so once the largest round has been seen the heap is not touched
+// again.
+size_t const ARENA_BLOCK_SIZE = 1 << 20;
+
+struct ArenaBlock {
+  std::unique_ptr<unsigned char[]> data;
+  size_t size = 0;
+};
+
+struct Arena {
+  std::vector<ArenaBlock> blocks;
+  int block = 0;
+  size_t offset = 0;
+
+  size_t bytes = 0;        // handed out this round
+  int allocations = 0;     // this round
+  size_t peakBytes = 0;    // most bytes any round has used
+  size_t lastRoundBytes = 0;
+  int lastRoundAllocations = 0;
+
+  Arena() = default;
+  // An arena belongs to the World it was made in. Copies (rollback
+  // snapshots) start out empty and keep their containers on the heap.
+  Arena(Arena const &) {}
+  Arena &operator=(Arena const &) { return *this; }
+};
+
+void *arenaAlloc(Arena &arena, size_t size) {
+  size_t const align = alignof(std::max_align_t);
+  size = (size + align - 1) & ~(align - 1);
+  while (arena.block < (int)arena.blocks.size() &&
+         arena.offset + size > arena.blocks[arena.block].size) {
+    arena.block++;
+    arena.offset = 0;
+  }
+  if (arena.block == (int)arena.blocks.size()) {
+    ArenaBlock block;
+    block.size = std::max(size, ARENA_BLOCK_SIZE);
+    block.data.reset(new unsigned char[block.size]);
+    arena.blocks.push_back(std::move(block));
+  }
+  void *p = arena.blocks[arena.block].data.get() + arena.offset;
+  arena.offset += size;
+  arena.bytes += size;
+  arena.allocations++;
+  arena.peakBytes = std::max(arena.peakBytes, arena.bytes);
+  return p;
+}
+
+// Everything allocated from the arena is dead after this. Containers that
+// still point into it must be emptied first.
+void resetArena(Arena &arena) {
+  arena.lastRoundBytes = arena.bytes;
+  arena.lastRoundAllocations = arena.allocations;
+  arena.block = 0;
+  arena.offset = 0;
+  arena.bytes = 0;
+  arena.allocations = 0;
+}
+
+// Standard allocator over an Arena, or over the heap when it has none.
+// Copy-constructed containers go to the heap, and assignment never moves a
+// container to another arena, so a World copied for rollback never shares
+// round memory with the live one.
+template <typename T>
+struct ArenaAllocator {
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::false_type;
+  using propagate_on_container_swap = std::false_type;
+
+  Arena *arena = nullptr;
+
+  ArenaAllocator() = default;
+  explicit ArenaAllocator(Arena *arena) : arena(arena) {}
+  template <typename U>
+  ArenaAllocator(ArenaAllocator<U> const &other) : arena(other.arena) {}
+
+  T *allocate(size_t n) {
+    if (!arena) return std::allocator<T>().allocate(n);
+    return (T *)arenaAlloc(*arena, n * sizeof(T));
+  }
+  void deallocate(T *p, size_t n) {
+    if (!arena) std::allocator<T>().deallocate(p, n);
+  }
+  ArenaAllocator select_on_container_copy_construction() const {
+    return ArenaAllocator();
+  }
+};
+
+template <typename T, typename U>
+bool operator==(ArenaAllocator<T> const &a, ArenaAllocator<U> const &b) {
+  return a.arena == b.arena;
+}
+template <typename T, typename U>
+bool operator!=(ArenaAllocator<T> const &a, ArenaAllocator<U> const &b) {
+  return a.arena != b.arena;
+}
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// Hand-placed spots from the map file, in tiles.
+enum MarkerType : uint32_t {
+  MARKER_SPAWN,
+  MARKER_GRENADE,
+};
+
+struct MapMarker {
+  uint32_t x;
+  uint32_t y;
+  uint32_t type;
+};
+
+// One bit per tile, row-major in a single allocation. Each row is padded to
+// whole 64-bit words, so asking whether a rectangle holds any solid tile is
+// a masked AND per row and per word.
+struct GameMap {
+  int width = 0;
+  int height = 0;
+  int wordsPerRow = 0;
+  ArenaVector<uint64_t> bits;
+  // Changes whenever the tiles do, and is never shared by two different
+  // layouts, so caches built from a map can tell when they are stale.
+  uint64_t revision = 0;
+  // Top-left corners where a standing player fits, from buildSpawnIndex.
+  ArenaVector<Vector2> spawns;
+  ArenaVector<MapMarker> markers;
+
+  GameMap() = default;
+  explicit GameMap(Arena *arena)
+      : bits(ArenaAllocator<uint64_t>(arena)),
+        spawns(ArenaAllocator<Vector2>(arena)),
+        markers(ArenaAllocator<MapMarker>(arena)) {}
+};
+
+// Maps are loaded on worker threads, and by several simulations at once.
+uint64_t nextMapRevision() {
+  static std::atomic<uint64_t> revision{0};
+  return ++revision;
+}
+
+void resizeMap(GameMap &map, int width, int height) {
+  map.revision = nextMapRevision();
+  map.width = width;
+  map.height = height;
+  map.wordsPerRow = (width + 63) / 64;
+  map.bits.assign((size_t)map.wordsPerRow * height, 0);
+  map.markers.clear();
+}
+
+// Tiles outside the map are empty.
+bool isSolid(GameMap const &map, int x, int y) {
+  if (x < 0 || y < 0 || x >= map.width || y >= map.height) return false;
+  return (map.bits[(size_t)y * map.wordsPerRow + (x >> 6)] >> (x & 63)) & 1;
+}
+
+void setTile(GameMap &map, int x, int y, Tile tile) {
+  uint64_t &word = map.bits[(size_t)y * map.wordsPerRow + (x >> 6)];
+  uint64_t bit = 1ULL << (x & 63);
+  if (tile == TILE) word |= bit;
+  else word &= ~bit;
+  map.revision = nextMapRevision();
+}
+
+// Bits of the given word that fall in the tile columns left..right.
+uint64_t columnMask(int word, int left, int right) {
+  int lo = std::max(left - word * 64, 0);
+  int hi = std::min(right - word * 64, 63);
+  return (~0ULL << lo) & (~0ULL >> (63 - hi));
+}
+
+// Simulation steps per second. The renderer interpolates between steps.
+float const DEFAULT_TICK_RATE = 120.0f;
+
+enum PlayerState {
+  GROUNDED 	= 1 << 0,
+  JUMPING 	= 1 << 1,
+  SLIDING 	= 1 << 2,
+  DASHING 	= 1 << 3,
+  DUCKING 	= 1 << 4,
+  ALIVE 		= 1 << 5,
+};
+
+bool hasFlag(uint32_t flags, PlayerState s) { return (flags & s) != 0; }
+void setFlag(uint32_t &flags, PlayerState s) { flags |= s; }
+void clearFlag(uint32_t &flags, PlayerState s) { flags &= ~s; }
+
+// Slot in a Pool plus the generation of the item it was handed out for.
+// Generation 0 is never live, so a default Handle refers to nothing.
+struct Handle {
+  uint16_t index = 0;
+  uint16_t generation = 0;
+};
+
+bool isNull(Handle h) { return h.generation == 0; }
+bool sameHandle(Handle a, Handle b) {
+  return a.index == b.index && a.generation == b.generation;
+}
+
+enum PickupType { GUN, GRENADE };
+
+struct Pickup {
+    PickupType type;
+    Vector2 position;
+    bool active = true;
+
+    Handle gun;
+    int grenadeAmount = 1;
+
+		int w = 20;
+		int h = 20;
+};
+
+// Stats shared by every gun of one kind, from the weapon table.
+struct GunArchetype {
+  char name[24];
+  // Guns must fit within one tile.
+  float w, h;
+  int ammo;
+  float fire_rate;
+  float projectile_speed;
+  float spread;
+  float range;
+};
+
+struct GrenadeParams {
+  float radius;
+  float fuse;
+  float bounce;
+  float throw_speed;
+  // Projectiles released when a grenade goes off.
+  int shrapnel;
+  float shrapnel_speed;
+  float shrapnel_range;
+};
+
+int const MAX_GUN_ARCHETYPES = 256;
+
+// Read-only once built and shared like maps, so worlds, snapshots and
+// hot reloads only ever swap a reference to it.
+struct WeaponTable {
+  // Never empty; Gun::archetype indexes it.
+  std::vector<GunArchetype> guns;
+  GrenadeParams grenade;
+};
+
+using WeaponsRef = std::shared_ptr<WeaponTable const>;
+
+struct Gun {
+  float x, y;
+  int ammo;
+  float cooldown = 0.0f;
+  uint8_t archetype = 0;
+  bool picked_up = false;
+};
+
+// Tables loaded later can have fewer kinds than guns already in play refer
+// to; those fall back to the last one.
+GunArchetype const &gunArchetype(WeaponTable const &weapons, Gun const &gun) {
+  return weapons.guns[std::min<size_t>(gun.archetype, weapons.guns.size() - 1)];
+}
+
+int const MAX_GUNS = 64;
+int const MAX_PICKUPS = 64;
+int const MAX_GRENADES = 64;
+
+// Fixed-capacity storage addressed through generational handles. Freed
+// slots go on a free list for reuse, and freeing bumps the slot's generation
+// so handles to the old occupant stop resolving instead of pointing at
+// whatever replaced it. Everything lives inline, so copying a pool never
+// allocates.
+template <typename T, int N>
+struct Pool {
+  std::array<T, N> items{};
+  std::array<uint16_t, N> generation{};
+  std::array<bool, N> live{};
+  std::array<uint16_t, N> freeSlots{};
+  int freeCount = 0;
+  int used = 0;
+  int count = 0;
+};
+
+// Null handle if the pool is full.
+template <typename T, int N>
+Handle createItem(Pool<T, N> &pool, T const &item) {
+  int slot;
+  if (pool.freeCount > 0) {
+    slot = pool.freeSlots[--pool.freeCount];
+  } else if (pool.used < N) {
+    slot = pool.used++;
+    pool.generation[slot] = 1;
+  } else {
+    return Handle{};
+  }
+  pool.items[slot] = item;
+  pool.live[slot] = true;
+  pool.count++;
+  return Handle{(uint16_t)slot, pool.generation[slot]};
+}
+
+// The item, or nullptr if the handle is null or its item was destroyed.
+template <typename T, int N>
+T *getItem(Pool<T, N> &pool, Handle h) {
+  if (isNull(h) || h.index >= pool.used || !pool.live[h.index] ||
+      pool.generation[h.index] != h.generation) {
+    return nullptr;
+  }
+  return &pool.items[h.index];
+}
+
+template <typename T, int N>
+T const *getItem(Pool<T, N> const &pool, Handle h) {
+  return getItem(const_cast<Pool<T, N> &>(pool), h);
+}
+
+template <typename T, int N>
+void freeSlot(Pool<T, N> &pool, int slot) {
+  pool.live[slot] = false;
+  if (++pool.generation[slot] == 0) pool.generation[slot] = 1;
+  pool.freeSlots[pool.freeCount++] = (uint16_t)slot;
+  pool.count--;
+}
+
+template <typename T, int N>
+void destroyItem(Pool<T, N> &pool, Handle h) {
+  if (getItem(pool, h)) freeSlot(pool, h.index);
+}
+
+// Frees every item. Later creates fill the lowest slots first.
+template <typename T, int N>
+void clearPool(Pool<T, N> &pool) {
+  pool.freeCount = 0;
+  for (int slot = pool.used - 1; slot >= 0; --slot) {
+    if (pool.live[slot]) {
+      pool.live[slot] = false;
+      if (++pool.generation[slot] == 0) pool.generation[slot] = 1;
+    }
+    pool.freeSlots[pool.freeCount++] = (uint16_t)slot;
+  }
+  pool.count = 0;
+}
+
+// Calls visit(item, handle) for every live item in slot order. Items may be
+// destroyed, but not created, from inside visit.
+template <typename T, int N, typename Visit>
+void forEachItem(Pool<T, N> &pool, Visit &&visit) {
+  for (int slot = 0; slot < pool.used; ++slot) {
+    if (pool.live[slot]) visit(pool.items[slot], Handle{(uint16_t)slot, pool.generation[slot]});
+  }
+}
+
+template <typename T, int N, typename Visit>
+void forEachItem(Pool<T, N> const &pool, Visit &&visit) {
+  for (int slot = 0; slot < pool.used; ++slot) {
+    if (pool.live[slot]) visit(pool.items[slot], Handle{(uint16_t)slot, pool.generation[slot]});
+  }
+}
+
+using GunPool = Pool<Gun, MAX_GUNS>;
+
+int const MAX_PROJECTILES = 2048;
+int const PROJECTILE_TRAIL = 30;
+int const GRENADE_TRAIL = 25;
+
+// The last N positions in a fixed ring, oldest first. Pushing into a full
+// trail overwrites the oldest point.
+template <int N>
+struct Trail {
+  Vector2 points[N];
+  uint8_t head = 0;
+  uint8_t count = 0;
+};
+
+template <int N>
+void pushTrail(Trail<N> &trail, Vector2 point) {
+  int slot = trail.head + trail.count;
+  if (slot >= N) slot -= N;
+  trail.points[slot] = point;
+  if (trail.count < N) {
+    trail.count++;
+  } else if (++trail.head == N) {
+    trail.head = 0;
+  }
+}
+
+template <int N>
+Vector2 trailPoint(Trail<N> const &trail, int i) {
+  int slot = trail.head + i;
+  if (slot >= N) slot -= N;
+  return trail.points[slot];
+}
+
+// Live projectiles stored as parallel arrays, packed into [0, count).
+// Storage is allocated once up front; spawning and removal never touch the
+// allocator and copies only move the live range.
+struct ProjectilePool {
+  int count = 0;
+  std::vector<float> x, y;
+  std::vector<float> prev_x, prev_y;
+  std::vector<float> dx, dy;
+  std::vector<float> traveled;
+  std::vector<float> max_distance;
+  std::vector<int> ownerId;
+  std::vector<Trail<PROJECTILE_TRAIL>> trail;
+
+  ProjectilePool()
+      : x(MAX_PROJECTILES), y(MAX_PROJECTILES),
+        prev_x(MAX_PROJECTILES), prev_y(MAX_PROJECTILES),
+        dx(MAX_PROJECTILES), dy(MAX_PROJECTILES),
+        traveled(MAX_PROJECTILES), max_distance(MAX_PROJECTILES),
+        ownerId(MAX_PROJECTILES), trail(MAX_PROJECTILES) {}
+
+  ProjectilePool(ProjectilePool const &other) : ProjectilePool() { *this = other; }
+
+  ProjectilePool &operator=(ProjectilePool const &other) {
+    count = other.count;
+    std::copy_n(other.x.begin(), count, x.begin());
+    std::copy_n(other.y.begin(), count, y.begin());
+    std::copy_n(other.prev_x.begin(), count, prev_x.begin());
+    std::copy_n(other.prev_y.begin(), count, prev_y.begin());
+    std::copy_n(other.dx.begin(), count, dx.begin());
+    std::copy_n(other.dy.begin(), count, dy.begin());
+    std::copy_n(other.traveled.begin(), count, traveled.begin());
+    std::copy_n(other.max_distance.begin(), count, max_distance.begin());
+    std::copy_n(other.ownerId.begin(), count, ownerId.begin());
+    std::copy_n(other.trail.begin(), count, trail.begin());
+    return *this;
+  }
+};
+
+// Returns false and drops the projectile when the pool is full.
+bool spawnProjectile(ProjectilePool &pool, float x, float y, float dx, float dy,
+                     float max_distance, int ownerId) {
+  if (pool.count >= MAX_PROJECTILES) return false;
+  int i = pool.count++;
+  pool.x[i] = pool.prev_x[i] = x;
+  pool.y[i] = pool.prev_y[i] = y;
+  pool.dx[i] = dx;
+  pool.dy[i] = dy;
+  pool.traveled[i] = 0.0f;
+  pool.max_distance[i] = max_distance;
+  pool.ownerId[i] = ownerId;
+  pool.trail[i] = {};
+  return true;
+}
+
+// Swap-removes projectile i with the last live one.
+void removeProjectile(ProjectilePool &pool, int i) {
+  int last = --pool.count;
+  if (i == last) return;
+  pool.x[i] = pool.x[last];
+  pool.y[i] = pool.y[last];
+  pool.prev_x[i] = pool.prev_x[last];
+  pool.prev_y[i] = pool.prev_y[last];
+  pool.dx[i] = pool.dx[last];
+  pool.dy[i] = pool.dy[last];
+  pool.traveled[i] = pool.traveled[last];
+  pool.max_distance[i] = pool.max_distance[last];
+  pool.ownerId[i] = pool.ownerId[last];
+  pool.trail[i] = pool.trail[last];
+}
+
+enum Action : uint16_t {
+    ACTION_LEFT     = 1 << 0,
+    ACTION_RIGHT    = 1 << 1,
+    ACTION_UP       = 1 << 2,
+    ACTION_DOWN     = 1 << 3,
+    ACTION_JUMP     = 1 << 4,
+    ACTION_DASH     = 1 << 5,
+    ACTION_FIRE     = 1 << 6,
+    ACTION_GRENADE  = 1 << 7,
+    ACTION_INTERACT = 1 << 8,
+};
+
+int const CONTROLS_KEYBOARD = -1;
+int const CONTROLS_SCRIPTED = -2;
+// Driven by a Bot, see bot.h.
+int const CONTROLS_BOT = -3;
+
+struct Controls {
+    int deviceId; 
+    int left, right, up, down, jump, dash, fire, grenade, interact;
+
+    // Action mask for the current and previous tick, see feedControls.
+    uint16_t held = 0;
+    uint16_t prevHeld = 0;
+};
+
+// Standing size of every player.
+float const PLAYER_W = 75.0f;
+float const PLAYER_H = 100.0f;
+// Replays store the player count in one byte.
+int const MAX_PLAYERS = 255;
+
+struct Player {
+  float x, y, w, h;
+  float prev_x, prev_y;
+  float original_h;
+  float dx, dy;
+  float max_vel;
+
+  float accel, drag, gravity, jump_force;
+  float dash_timer, slide_timer;
+
+  float dash_speed;
+  float dash_duration;
+  float slide_duration;
+  float duck_scale;
+
+	int health;
+  int max_health;
+	int id;
+
+  Handle gun;
+	int kills = 0;
+  float hitTimer = 0.0f;
+	float respawnTimer = 0.0f;
+  int facing;
+  uint32_t status_flags;
+
+	int grenadeCount = 2;
+	int maxGrenades = 3;
+	bool canInteract = false;
+	Handle nearbyPickup;
+
+	Controls controls;
+};
+
+struct Grenade {
+    float x, y;
+    float prev_x, prev_y;
+    float dx, dy;
+    float radius;
+    float fuse;              
+    float bounce;            
+    bool exploded = false;
+    Trail<GRENADE_TRAIL> trail;
+};
+
+using PickupPool = Pool<Pickup, MAX_PICKUPS>;
+using GrenadePool = Pool<Grenade, MAX_GRENADES>;
+
+enum GameState {
+    ROUND_ACTIVE,
+    ROUND_OVER,
+    MATCH_OVER
+};
+
+// PCG32. Every random decision in the simulation draws from the match's
+// stream, so the seed plus the per-tick input reproduces a whole match.
+struct Rng {
+    uint64_t state = 0x853c49e6748fea9bULL;
+    uint64_t inc = 0xda3e39cb94b95bdbULL;
+};
+
+uint32_t nextRandom(Rng &rng) {
+    uint64_t old = rng.state;
+    rng.state = old * 6364136223846793005ULL + rng.inc;
+    uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+    uint32_t rot = (uint32_t)(old >> 59u);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+void seedRng(Rng &rng, uint64_t seed) {
+    rng.state = 0;
+    rng.inc = (seed << 1u) | 1u;
+    nextRandom(rng);
+    rng.state += seed;
+    nextRandom(rng);
+}
+
+// Inclusive on both ends, same contract as GetRandomValue.
+int randomRange(Rng &rng, int min, int max) {
+    if (max <= min) return min;
+    uint32_t span = (uint32_t)(max - min) + 1u;
+    return min + (int)(nextRandom(rng) % span);
+}
+
+// Uniform in [0, 1).
+float randomFloat(Rng &rng) {
+    return (nextRandom(rng) >> 8) * (1.0f / 16777216.0f);
+}
+
+struct MatchInfo {
+    int totalRounds = 5;    
+    int currentRound = 1;
+    // Rounds won, per player.
+    std::vector<int> wins;
+    GameState state = ROUND_ACTIVE;
+    float roundOverTimer = 0.0f;
+    std::vector<std::string> mapFiles;
+    uint64_t seed = 0;
+    Rng rng;
+};
+
+
+uint64_t const FNV_OFFSET = 0xcbf29ce484222325ULL;
+
+uint64_t hashBytes(uint64_t hash, void const *data, size_t size) {
+    unsigned char const *bytes = (unsigned char const *)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+template <typename T>
+uint64_t hashValue(uint64_t hash, T const &value) {
+    return hashBytes(hash, &value, sizeof(value));
+}
+
+// Gap left between a spawned player's feet and the floor.
+float const SPAWN_CLEARANCE = 1.0f;
+
+// Whether a player standing on the floor tiles starting at (x, y) has
+// nothing solid above them.
+bool spawnFits(GameMap const &map, int x, int y, int tilesWide, int tilesHigh) {
+    for (int i = 0; i < tilesWide; ++i) {
+        if (!isSolid(map, x + i, y)) return false;
+        for (int j = 1; j <= tilesHigh; ++j) {
+            if (isSolid(map, x + i, y - j)) return false;
+        }
+    }
+    return true;
+}
+
+// Finds every spot where a standing player is centred on a run of floor
+// tiles with nothing solid in the way, bottom row first. Spawn markers, when
+// the map has any, replace the search: each one drops to the first floor
+// below it that fits. Must be rerun whenever the tiles change.
+void buildSpawnIndex(GameMap &map) {
+    map.spawns.clear();
+    int tilesWide = (int)ceil(PLAYER_W / TILE_SIZE);
+    int tilesHigh = (int)ceil((PLAYER_H + SPAWN_CLEARANCE) / TILE_SIZE);
+    auto addSpawn = [&](int x, int y) {
+        map.spawns.push_back({
+            x * TILE_SIZE + (TILE_SIZE * tilesWide - PLAYER_W) * 0.5f,
+            y * TILE_SIZE - PLAYER_H - SPAWN_CLEARANCE
+        });
+    };
+
+    bool marked = false;
+    for (MapMarker const &marker : map.markers) {
+        if (marker.type != MARKER_SPAWN) continue;
+        marked = true;
+        for (int y = (int)marker.y + 1; y < map.height; ++y) {
+            if (spawnFits(map, (int)marker.x, y, tilesWide, tilesHigh)) {
+                addSpawn((int)marker.x, y);
+                break;
+            }
+        }
+    }
+    for (int y = map.height - 1; y > 0 && !marked; --y) {
+        for (int x = 0; x <= map.width - tilesWide; ++x) {
+            if (spawnFits(map, x, y, tilesWide, tilesHigh)) addSpawn(x, y);
+        }
+    }
+    if (map.spawns.empty()) {
+        TraceLog(LOG_WARNING, "No valid floor found for spawn!");
+    }
+}
+
+// Rebuilds everything derived from the tiles.
+void buildMapIndices(GameMap &map) {
+    buildSpawnIndex(map);
+}
+
+// Largest width or height either map format accepts.
+int const MAX_MAP_SIZE = 1 << 16;
+
+// Floor along the bottom and random platform runs every few rows, dense
+// enough that there is always something to jump to.
+void generateMap(GameMap &map, int width, int height, uint64_t seed) {
+    Rng rng;
+    seedRng(rng, seed);
+    resizeMap(map, width, height);
+    for (int x = 0; x < width; x++) setTile(map, x, height - 1, TILE);
+    for (int y = 4; y < height - 1; y += 3) {
+        for (int x = randomRange(rng, 0, 8); x < width; x += randomRange(rng, 4, 16)) {
+            int run = randomRange(rng, 3, 12);
+            for (int i = 0; i < run && x < width; i++, x++) setTile(map, x, y, TILE);
+        }
+    }
+}
+
+// "generate:WxH:SEED" names a generated map instead of a file, so scenarios
+// and replays can refer to large maps without shipping them.
+bool generateMapFromName(std::string const &path, GameMap &map) {
+    int width, height;
+    unsigned long long seed;
+    if (sscanf(path.c_str(), "generate:%dx%d:%llu", &width, &height, &seed) != 3 ||
+        width <= 0 || height <= 0 || width > MAX_MAP_SIZE || height > MAX_MAP_SIZE) {
+        TraceLog(LOG_ERROR, "Invalid generated map name: %s", path.c_str());
+        return false;
+    }
+    generateMap(map, width, height, seed);
+    return true;
+}
+
+// Text maps are a "W H" header line followed by H rows of W tiles:
+// '#' solid, '.' empty, 'S' a spawn marker, 'G' a grenade pickup marker.
+// Markers are empty tiles.
+bool parseTextMap(std::string const &path, GameMap &map) {
+    FILE *file = fopen(path.c_str(), "r");
+    if (!file) {
+        TraceLog(LOG_ERROR, "Failed to open map file: %s", path.c_str());
+        return false;
+    }
+    int width, height;
+    if (fscanf(file, "%d %d", &width, &height) != 2) {
+        TraceLog(LOG_ERROR, "%s:1: invalid map header, expected \"WIDTH HEIGHT\"", path.c_str());
+        fclose(file);
+        return false;
+    }
+    if (width <= 0 || height <= 0 || width > MAX_MAP_SIZE || height > MAX_MAP_SIZE) {
+        TraceLog(LOG_ERROR, "%s:1: map size %dx%d out of range", path.c_str(), width, height);
+        fclose(file);
+        return false;
+    }
+    int c;
+    while ((c = fgetc(file)) != EOF && c != '\n') {}
+    resizeMap(map, width, height);
+
+    bool ok = true;
+    for (int y = 0; y < height && ok; ++y) {
+        int line = y + 2;
+        int x = 0;
+        while (ok && (c = fgetc(file)) != EOF && c != '\n') {
+            if (c == '\r') continue;
+            if (x >= width) {
+                TraceLog(LOG_ERROR, "%s:%d: row is longer than %d tiles", path.c_str(), line, width);
+                ok = false;
+                continue;
+            }
+            switch (c) {
+            case '#': setTile(map, x, y, TILE); break;
+            case '.': break;
+            case 'S': map.markers.push_back({(uint32_t)x, (uint32_t)y, MARKER_SPAWN}); break;
+            case 'G': map.markers.push_back({(uint32_t)x, (uint32_t)y, MARKER_GRENADE}); break;
+            default:
+                TraceLog(LOG_ERROR, "%s:%d:%d: unknown tile '%c'", path.c_str(), line, x + 1, c);
+                ok = false;
+            }
+            x++;
+        }
+        if (ok && x != width) {
+            if (c == EOF && x == 0) {
+                TraceLog(LOG_ERROR, "%s:%d: file ends after %d of %d rows", path.c_str(), line, y, height);
+            } else {
+                TraceLog(LOG_ERROR, "%s:%d: row has %d tiles, expected %d", path.c_str(), line, x, width);
+            }
+            ok = false;
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+// Compiled maps (.tdm) hold the tiles in exactly the layout GameMap keeps
+// them in, so loading one is a validation pass and a memcpy out of the
+// mapped file:
+//
+//   TdmHeader
+//   height x wordsPerRow u64 tile words, bit x & 63 of word x >> 6 per row
+//   markerCount x MapMarker
+//
+// The checksum is FNV-1a over everything after the header. All integers are
+// little-endian, as in replays.
+uint32_t const TDM_MAGIC = 0x504d4454; // "TDMP"
+uint16_t const TDM_VERSION = 1;
+
+struct TdmHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t width;
+    uint32_t height;
+    uint32_t wordsPerRow;
+    uint32_t markerCount;
+    uint64_t checksum;
+};
+static_assert(sizeof(TdmHeader) == 32, "TdmHeader must match the file layout");
+static_assert(sizeof(MapMarker) == 12, "MapMarker must match the file layout");
+
+bool writeCompiledMap(std::string const &path, GameMap const &map) {
+    TdmHeader header = {};
+    header.magic = TDM_MAGIC;
+    header.version = TDM_VERSION;
+    header.headerSize = sizeof(TdmHeader);
+    header.width = (uint32_t)map.width;
+    header.height = (uint32_t)map.height;
+    header.wordsPerRow = (uint32_t)map.wordsPerRow;
+    header.markerCount = (uint32_t)map.markers.size();
+    size_t tileBytes = map.bits.size() * sizeof(uint64_t);
+    size_t markerBytes = map.markers.size() * sizeof(MapMarker);
+    header.checksum = hashBytes(hashBytes(FNV_OFFSET, map.bits.data(), tileBytes),
+                                map.markers.data(), markerBytes);
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) {
+        TraceLog(LOG_ERROR, "Failed to open map file for writing: %s", path.c_str());
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(map.bits.data(), 1, tileBytes, file) == tileBytes &&
+              fwrite(map.markers.data(), 1, markerBytes, file) == markerBytes;
+    ok = fclose(file) == 0 && ok;
+    if (!ok) TraceLog(LOG_ERROR, "Failed to write map file: %s", path.c_str());
+    return ok;
+}
+
+struct MappedFile {
+    unsigned char const *data = nullptr;
+    size_t size = 0;
+};
+
+bool mapFile(std::string const &path, MappedFile &file) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && st.st_size > 0;
+    if (ok) {
+        void *data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ok = data != MAP_FAILED;
+        if (ok) {
+            file.data = (unsigned char const *)data;
+            file.size = (size_t)st.st_size;
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+void unmapFile(MappedFile &file) {
+    if (file.data) munmap((void *)file.data, file.size);
+    file = MappedFile();
+}
+
+bool loadCompiledMap(std::string const &path, GameMap &map) {
+    MappedFile file;
+    if (!mapFile(path, file)) {
+        TraceLog(LOG_ERROR, "Failed to open map file: %s", path.c_str());
+        return false;
+    }
+    TdmHeader header;
+    const char *error = nullptr;
+    size_t tileBytes = 0, markerBytes = 0;
+    if (file.size < sizeof(TdmHeader)) {
+        error = "file is shorter than the header";
+    } else {
+        memcpy(&header, file.data, sizeof(header));
+        tileBytes = (size_t)header.height * header.wordsPerRow * sizeof(uint64_t);
+        markerBytes = (size_t)header.markerCount * sizeof(MapMarker);
+        if (header.magic != TDM_MAGIC) {
+            error = "not a compiled map";
+        } else if (header.version != TDM_VERSION || header.headerSize != sizeof(TdmHeader)) {
+            error = "unsupported version";
+        } else if (header.width == 0 || header.height == 0 ||
+                   header.width > MAX_MAP_SIZE || header.height > MAX_MAP_SIZE ||
+                   header.wordsPerRow != (header.width + 63) / 64) {
+            error = "bad map dimensions";
+        } else if (file.size != sizeof(TdmHeader) + tileBytes + markerBytes) {
+            error = "file size does not match the header";
+        } else if (hashBytes(FNV_OFFSET, file.data + sizeof(TdmHeader), tileBytes + markerBytes) !=
+                   header.checksum) {
+            error = "checksum mismatch";
+        }
+    }
+    if (!error) {
+        resizeMap(map, (int)header.width, (int)header.height);
+        memcpy(map.bits.data(), file.data + sizeof(TdmHeader), tileBytes);
+        map.markers.resize(header.markerCount);
+        memcpy(map.markers.data(), file.data + sizeof(TdmHeader) + tileBytes, markerBytes);
+        for (MapMarker const &marker : map.markers) {
+            if (marker.x >= header.width || marker.y >= header.height) {
+                error = "marker outside the map";
+                break;
+            }
+        }
+    }
+    unmapFile(file);
+    if (error) {
+        TraceLog(LOG_ERROR, "%s: %s", path.c_str(), error);
+        return false;
+    }
+    return true;
+}
+
+bool endsWith(std::string const &s, const char *suffix) {
+    size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+std::string compiledMapPath(std::string const &path) {
+    if (endsWith(path, ".map")) return path.substr(0, path.size() - 4) + ".tdm";
+    return path + ".tdm";
+}
+
+// A compiled map is only trusted while it is at least as new as its source.
+bool hasFreshCompiledMap(std::string const &path) {
+    struct stat source, compiled;
+    if (stat(compiledMapPath(path).c_str(), &compiled) != 0) return false;
+    return stat(path.c_str(), &source) != 0 || compiled.st_mtime >= source.st_mtime;
+}
+
+// Loads a .tdm directly, or a text map through its compiled .tdm when mapc
+// has produced an up to date one. The map's containers allocate from arena,
+// or the heap when it is null. Returns an empty map when loading fails.
+GameMap loadMapFromFile(const std::string& path, Arena *arena = nullptr) {
+    GameMap map(arena);
+    auto start = std::chrono::steady_clock::now();
+    std::string source = path;
+    bool ok;
+    if (path.compare(0, 9, "generate:") == 0) {
+        ok = generateMapFromName(path, map);
+    } else if (endsWith(path, ".tdm")) {
+        ok = loadCompiledMap(path, map);
+    } else if (hasFreshCompiledMap(path)) {
+        source = compiledMapPath(path);
+        ok = loadCompiledMap(source, map);
+        if (!ok) {
+            TraceLog(LOG_WARNING, "Falling back to text map: %s", path.c_str());
+            source = path;
+            ok = parseTextMap(path, map);
+        }
+    } else {
+        ok = parseTextMap(path, map);
+    }
+    if (!ok) return GameMap(arena);
+
+    buildMapIndices(map);
+    double ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    TraceLog(LOG_INFO, "Loaded map %s (%dx%d) in %.3f ms", source.c_str(),
+             map.width, map.height, ms);
+    return map;
+}
+
+// Loaded maps are immutable and shared: by every World playing them, by
+// rollback snapshots, and across rounds and restarts. Each file is loaded
+// once per process on a worker thread, so a round transition only has to
+// take a reference to a map that was prepared while the previous round was
+// still running.
+using MapRef = std::shared_ptr<GameMap const>;
+
+struct MapCache {
+    std::mutex mutex;
+    std::map<std::string, std::shared_future<MapRef>> maps;
+};
+
+MapCache &mapCache() {
+    static MapCache cache;
+    return cache;
+}
+
+// Starts loading path in the background unless it is loaded or loading.
+std::shared_future<MapRef> requestMap(std::string const &path) {
+    MapCache &cache = mapCache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto it = cache.maps.find(path);
+    if (it != cache.maps.end()) return it->second;
+    std::shared_future<MapRef> loading = std::async(std::launch::async, [path]() {
+        return MapRef(std::make_shared<GameMap const>(loadMapFromFile(path)));
+    }).share();
+    cache.maps.emplace(path, loading);
+    return loading;
+}
+
+void preloadMap(std::string const &path) {
+    requestMap(path);
+}
+
+// Waits for the map if its preload has not finished yet.
+MapRef acquireMap(std::string const &path) {
+    return requestMap(path).get();
+}
+
+// The map if it is loaded, without waiting; null otherwise.
+MapRef readyMap(std::string const &path) {
+    std::shared_future<MapRef> loading = requestMap(path);
+    if (loading.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return nullptr;
+    return loading.get();
+}
+
+// Loads path again right away and replaces the cached copy, so later
+// requests get the new tiles. Worlds already holding the old map keep it
+// until they switch. Returns null, and keeps the cached copy, if the file
+// no longer loads.
+MapRef reloadMap(std::string const &path) {
+    GameMap map = loadMapFromFile(path);
+    if (map.width == 0 || map.height == 0) {
+        TraceLog(LOG_WARNING, "Keeping the previous version of %s", path.c_str());
+        return nullptr;
+    }
+    MapRef loaded = std::make_shared<GameMap const>(std::move(map));
+    std::promise<MapRef> ready;
+    ready.set_value(loaded);
+    MapCache &cache = mapCache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    cache.maps[path] = ready.get_future().share();
+    return loaded;
+}
+
+MapRef emptyMap() {
+    static MapRef empty = std::make_shared<GameMap const>();
+    return empty;
+}
+
+std::string const &roundMapFile(MatchInfo const &match, int round) {
+    return match.mapFiles[(round - 1) % match.mapFiles.size()];
+}
+
+// Reports map files written since the last poll, through inotify watches
+// on their directories. Editors that save by renaming a temporary file over
+// the original still show up, and so does mapc rewriting a map's .tdm.
+struct MapWatch {
+    int fd = -1;
+    // Directory prefix ("" or ending in '/') for each watch descriptor.
+    std::map<int, std::string> dirs;
+    std::vector<std::string> files;
+};
+
+bool openMapWatch(MapWatch &watch, std::vector<std::string> const &files) {
+    watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch.fd < 0) {
+        TraceLog(LOG_WARNING, "Map hot reload unavailable: inotify_init1 failed");
+        return false;
+    }
+    for (std::string const &path : files) {
+        if (path.compare(0, 9, "generate:") == 0) continue;
+        watch.files.push_back(path);
+        size_t slash = path.rfind('/');
+        std::string prefix = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+        std::string dir = prefix.empty() ? "." : prefix;
+        int wd = inotify_add_watch(watch.fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0) {
+            TraceLog(LOG_WARNING, "Cannot watch %s for map changes", dir.c_str());
+            continue;
+        }
+        watch.dirs[wd] = prefix;
+    }
+    return true;
+}
+
+void closeMapWatch(MapWatch &watch) {
+    if (watch.fd >= 0) close(watch.fd);
+    watch = MapWatch();
+}
+
+// Appends each watched map whose source or compiled file changed. Never
+// blocks.
+void pollMapWatch(MapWatch &watch, std::vector<std::string> &changed) {
+    if (watch.fd < 0) return;
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = read(watch.fd, buffer, sizeof(buffer))) > 0) {
+        for (char *at = buffer; at < buffer + length;) {
+            inotify_event const *event = (inotify_event const *)at;
+            at += sizeof(inotify_event) + event->len;
+            auto dir = watch.dirs.find(event->wd);
+            if (event->len == 0 || dir == watch.dirs.end()) continue;
+            std::string written = dir->second + event->name;
+            for (std::string const &path : watch.files) {
+                if (written != path && written != compiledMapPath(path)) continue;
+                if (std::find(changed.begin(), changed.end(), path) == changed.end()) {
+                    changed.push_back(path);
+                }
+            }
+        }
+    }
+}
+
+bool isDeviceDown(Controls const &c, int button) {
+    if (c.deviceId == CONTROLS_KEYBOARD) {
+        return IsKeyDown(button);
+    } else {
+        return IsGamepadButtonDown(c.deviceId, button);
+    }
+}
+
+// Samples the bound keyboard/gamepad into an action mask. Scripted and bot
+// controls are fed from outside and keep whatever was last written to them.
+uint16_t pollControls(Controls const &c) {
+    if (c.deviceId == CONTROLS_SCRIPTED || c.deviceId == CONTROLS_BOT) return c.held;
+
+    uint16_t held = 0;
+    if (isDeviceDown(c, c.left))     held |= ACTION_LEFT;
+    if (isDeviceDown(c, c.right))    held |= ACTION_RIGHT;
+    if (isDeviceDown(c, c.up))       held |= ACTION_UP;
+    if (isDeviceDown(c, c.down))     held |= ACTION_DOWN;
+    if (isDeviceDown(c, c.jump))     held |= ACTION_JUMP;
+    if (isDeviceDown(c, c.dash))     held |= ACTION_DASH;
+    if (isDeviceDown(c, c.fire))     held |= ACTION_FIRE;
+    if (isDeviceDown(c, c.grenade))  held |= ACTION_GRENADE;
+    if (isDeviceDown(c, c.interact)) held |= ACTION_INTERACT;
+    return held;
+}
+
+// Fixed input pattern so headless runs exercise movement, dashing, sliding,
+// shooting and grenades without a device attached.
+uint16_t scriptedInput(int playerId, uint64_t tick) {
+    uint64_t t = tick + (uint64_t)playerId * 37;
+    uint16_t held = ((t / 90) % 2 == 0) ? ACTION_RIGHT : ACTION_LEFT;
+
+    if (t % 45 < 10)           held |= ACTION_JUMP;
+    if (t % 240 == 0)          held |= ACTION_DASH;
+    if ((t / 200) % 5 == 4)    held |= ACTION_DOWN;
+    if (t % 30 < 2)            held |= ACTION_INTERACT;
+    if (t % 300 == 150)        held |= ACTION_GRENADE;
+    held |= ACTION_FIRE;
+    return held;
+}
+
+void feedControls(Controls &c, uint16_t held) {
+    c.prevHeld = c.held;
+    c.held = held;
+}
+
+bool isActionDown(Controls const &c, Action action) {
+    return (c.held & action) != 0;
+}
+
+bool isActionPressed(Controls const &c, Action action) {
+    return (c.held & action) && !(c.prevHeld & action);
+}
+
+bool isActionReleased(Controls const &c, Action action) {
+    return !(c.held & action) && (c.prevHeld & action);
+}
+
+
+
+// Tiles a rectangle can overlap, clamped to the map. Empty (right < left
+// or bottom < top) when the rectangle lies outside it.
+struct TileRange {
+  int left, top, right, bottom;
+};
+
+TileRange tilesOverlapping(GameMap const &map, Rectangle rect) {
+  int rows = map.height;
+  int cols = map.width;
+
+  TileRange r;
+  r.left = std::max(0, (int)std::floor(rect.x / TILE_SIZE));
+  r.right =
+      std::min(cols - 1, (int)std::floor((rect.x + rect.width) / TILE_SIZE));
+  r.top = std::max(0, (int)std::floor(rect.y / TILE_SIZE));
+  r.bottom =
+      std::min(rows - 1, (int)std::floor((rect.y + rect.height) / TILE_SIZE));
+  return r;
+}
+
+// Calls visit(tileRect) for every solid tile in the rectangle's tile range,
+// row by row. Tiles that only touch the rectangle's edge are included, so
+// callers still test for actual overlap.
+template <typename Visit>
+void forEachSolidTile(GameMap const &map, Rectangle rect, Visit &&visit) {
+  TileRange r = tilesOverlapping(map, rect);
+  for (int y = r.top; y <= r.bottom; ++y) {
+    uint64_t const *row = &map.bits[(size_t)y * map.wordsPerRow];
+    for (int w = r.left >> 6; w <= r.right >> 6; ++w) {
+      uint64_t word = row[w] & columnMask(w, r.left, r.right);
+      while (word) {
+        int x = w * 64 + __builtin_ctzll(word);
+        word &= word - 1;
+        visit(Rectangle{(float)x * TILE_SIZE, (float)y * TILE_SIZE,
+                        (float)TILE_SIZE, (float)TILE_SIZE});
+      }
+    }
+  }
+}
+
+// Whether any tile in the inclusive tile range is solid. The range must
+// already be clamped to the map.
+bool anySolidTile(GameMap const &map, TileRange r) {
+  if (r.left > r.right) return false;
+  int firstWord = r.left >> 6;
+  int lastWord = r.right >> 6;
+  for (int y = r.top; y <= r.bottom; ++y) {
+    uint64_t const *row = &map.bits[(size_t)y * map.wordsPerRow];
+    for (int w = firstWord; w <= lastWord; ++w) {
+      if (row[w] & columnMask(w, r.left, r.right)) return true;
+    }
+  }
+  return false;
+}
+
+// Number of empty tiles in the inclusive, clamped tile range.
+int countFreeTiles(GameMap const &map, TileRange r) {
+  int count = 0;
+  for (int y = r.top; y <= r.bottom; ++y) {
+    uint64_t const *row = &map.bits[(size_t)y * map.wordsPerRow];
+    for (int w = r.left >> 6; w <= r.right >> 6; ++w) {
+      count += __builtin_popcountll(~row[w] & columnMask(w, r.left, r.right));
+    }
+  }
+  return count;
+}
+
+// Index (y * width + x) of the n-th empty tile of the range in row-major
+// order; n must be below countFreeTiles(map, r).
+int nthFreeTile(GameMap const &map, TileRange r, int n) {
+  for (int y = r.top; y <= r.bottom; ++y) {
+    uint64_t const *row = &map.bits[(size_t)y * map.wordsPerRow];
+    for (int w = r.left >> 6; w <= r.right >> 6; ++w) {
+      uint64_t word = ~row[w] & columnMask(w, r.left, r.right);
+      int count = __builtin_popcountll(word);
+      if (n < count) {
+        for (; n > 0; --n) word &= word - 1;
+        return y * map.width + w * 64 + __builtin_ctzll(word);
+      }
+      n -= count;
+    }
+  }
+  return -1;
+}
+
+// True if the rectangle overlaps a solid tile. Only tiles it actually
+// overlaps are tested; touching an edge is not a collision.
+bool hasMapCollision(GameMap const &map, Rectangle rect) {
+  TileRange r;
+  r.left = std::max(0, (int)std::floor(rect.x / TILE_SIZE));
+  r.right = std::min(map.width - 1,
+                     (int)std::ceil((rect.x + rect.width) / TILE_SIZE) - 1);
+  r.top = std::max(0, (int)std::floor(rect.y / TILE_SIZE));
+  r.bottom = std::min(map.height - 1,
+                      (int)std::ceil((rect.y + rect.height) / TILE_SIZE) - 1);
+  return anySolidTile(map, r);
+}
+
+bool hasMapCollision(GameMap const &map, Player const &player) {
+  return hasMapCollision(map, Rectangle{player.x, player.y, player.w, player.h});
+}
+
+// Result of sweeping a moving box: the fraction t of the move that can be
+// made before contact, and the normal of the face that was hit.
+struct SweepHit {
+  bool hit = false;
+  bool startsInside = false;
+  float t = 1.0f;
+  float nx = 0.0f;
+  float ny = 0.0f;
+};
+
+// Boxes closer than this count as touching, so a box resting flush against
+// a wall is blocked instead of re-entering it through rounding error. Movers
+// also stop this far short of what they hit.
+float const SWEEP_SKIN = 0.01f;
+
+// Sweeps box by (move_x, move_y) against a static target. A box that starts
+// inside the target hits at t = 0 and is flagged startsInside, unless it is
+// only within SWEEP_SKIN of a face and moving away from it.
+SweepHit sweepRect(Rectangle box, float move_x, float move_y, Rectangle target) {
+  SweepHit result;
+  float entry_x = -FLT_MAX, exit_x = FLT_MAX;
+  float entry_y = -FLT_MAX, exit_y = FLT_MAX;
+
+  if (move_x > 0.0f) {
+    entry_x = (target.x - (box.x + box.width)) / move_x;
+    exit_x = (target.x + target.width - box.x) / move_x;
+  } else if (move_x < 0.0f) {
+    entry_x = (target.x + target.width - box.x) / move_x;
+    exit_x = (target.x - (box.x + box.width)) / move_x;
+  } else if (box.x >= target.x + target.width || box.x + box.width <= target.x) {
+    return result;
+  }
+  if (move_y > 0.0f) {
+    entry_y = (target.y - (box.y + box.height)) / move_y;
+    exit_y = (target.y + target.height - box.y) / move_y;
+  } else if (move_y < 0.0f) {
+    entry_y = (target.y + target.height - box.y) / move_y;
+    exit_y = (target.y - (box.y + box.height)) / move_y;
+  } else if (box.y >= target.y + target.height || box.y + box.height <= target.y) {
+    return result;
+  }
+
+  float entry = std::max(entry_x, entry_y);
+  float exit = std::min(exit_x, exit_y);
+  if (entry >= exit || entry > 1.0f || exit <= 0.0f) return result;
+
+  if (entry >= 0.0f) {
+    result.hit = true;
+    result.t = entry;
+    if (entry_x > entry_y) result.nx = move_x > 0.0f ? -1.0f : 1.0f;
+    else result.ny = move_y > 0.0f ? -1.0f : 1.0f;
+    return result;
+  }
+
+  // Already overlapping: push out along the shallower axis.
+  float left = box.x + box.width - target.x;
+  float right = target.x + target.width - box.x;
+  float top = box.y + box.height - target.y;
+  float bottom = target.y + target.height - box.y;
+  float depth_x = std::min(left, right);
+  float depth_y = std::min(top, bottom);
+  result.t = 0.0f;
+  if (depth_x < depth_y) {
+    result.nx = left < right ? -1.0f : 1.0f;
+    if (depth_x <= SWEEP_SKIN) {
+      result.hit = move_x * result.nx < 0.0f;
+      return result;
+    }
+  } else {
+    result.ny = top < bottom ? -1.0f : 1.0f;
+    if (depth_y <= SWEEP_SKIN) {
+      result.hit = move_y * result.ny < 0.0f;
+      return result;
+    }
+  }
+  result.hit = true;
+  result.startsInside = true;
+  return result;
+}
+
+// Earliest hit of box moving by (move_x, move_y) against the map's solid
+// tiles. Tiles the box already sits deep inside are skipped unless
+// hitInside is set, so a player stuck in a wall can still walk out of it.
+SweepHit sweepMap(GameMap const &map, Rectangle box, float move_x, float move_y,
+                  bool hitInside) {
+  Rectangle swept = {std::min(box.x, box.x + move_x),
+                     std::min(box.y, box.y + move_y),
+                     box.width + fabsf(move_x), box.height + fabsf(move_y)};
+  SweepHit best;
+  forEachSolidTile(map, swept, [&](Rectangle tile) {
+    SweepHit hit = sweepRect(box, move_x, move_y, tile);
+    if (!hit.hit || (hit.startsInside && !hitInside)) return;
+    if (!best.hit || hit.t < best.t) best = hit;
+  });
+  return best;
+}
+
+// Uniform grid for entity-vs-entity overlap queries, rebuilt every tick.
+// Cells are hashed into a fixed table of buckets, so the grid covers any
+// map size, and the bucket contents are stored flat by a counting sort.
+int const HASH_CELL = 128;
+int const HASH_BUCKETS = 1024;
+
+struct SpatialHash {
+  ArenaVector<int> bucketStart;
+  ArenaVector<int> entries;
+  ArenaVector<std::pair<int, int>> pending;
+  ArenaVector<uint32_t> stamp;
+  uint32_t query = 0;
+  ArenaVector<int> found;
+
+  SpatialHash() = default;
+  explicit SpatialHash(Arena *arena)
+      : bucketStart(ArenaAllocator<int>(arena)), entries(ArenaAllocator<int>(arena)),
+        pending(ArenaAllocator<std::pair<int, int>>(arena)),
+        stamp(ArenaAllocator<uint32_t>(arena)), found(ArenaAllocator<int>(arena)) {}
+  // Only scratch state, rebuilt before every use, so copying a World (for
+  // rollback snapshots) leaves the destination's grid alone.
+  SpatialHash(SpatialHash const &) {}
+  SpatialHash &operator=(SpatialHash const &) { return *this; }
+};
+
+int hashBucket(int cx, int cy) {
+  return (int)(((uint32_t)cx * 73856093u) ^ ((uint32_t)cy * 19349663u)) &
+         (HASH_BUCKETS - 1);
+}
+
+// Cells covered by rect, inclusive.
+TileRange hashCells(Rectangle rect) {
+  TileRange r;
+  r.left = (int)std::floor(rect.x / HASH_CELL);
+  r.right = (int)std::floor((rect.x + rect.width) / HASH_CELL);
+  r.top = (int)std::floor(rect.y / HASH_CELL);
+  r.bottom = (int)std::floor((rect.y + rect.height) / HASH_CELL);
+  return r;
+}
+
+void clearHash(SpatialHash &hash) {
+  hash.pending.clear();
+}
+
+// Drops the buffers' storage, for when the memory behind them is about to
+// be reset.
+template <typename T>
+void releaseVector(ArenaVector<T> &v) {
+  ArenaVector<T>(v.get_allocator()).swap(v);
+}
+
+void releaseHash(SpatialHash &hash) {
+  releaseVector(hash.bucketStart);
+  releaseVector(hash.entries);
+  releaseVector(hash.pending);
+  releaseVector(hash.stamp);
+  releaseVector(hash.found);
+}
+
+void insertHash(SpatialHash &hash, int id, Rectangle bounds) {
+  TileRange r = hashCells(bounds);
+  for (int cy = r.top; cy <= r.bottom; ++cy) {
+    for (int cx = r.left; cx <= r.right; ++cx) {
+      hash.pending.push_back({hashBucket(cx, cy), id});
+    }
+  }
+}
+
+// Sorts the inserted items into their buckets. Call after the last insert
+// and before the first query.
+void finishHash(SpatialHash &hash) {
+  hash.bucketStart.assign(HASH_BUCKETS + 1, 0);
+  int maxId = -1;
+  for (auto const &[bucket, id] : hash.pending) {
+    hash.bucketStart[bucket + 1]++;
+    maxId = std::max(maxId, id);
+  }
+  for (int b = 0; b < HASH_BUCKETS; ++b) {
+    hash.bucketStart[b + 1] += hash.bucketStart[b];
+  }
+  hash.entries.resize(hash.pending.size());
+  for (auto const &[bucket, id] : hash.pending) {
+    hash.entries[hash.bucketStart[bucket]++] = id;
+  }
+  for (int b = HASH_BUCKETS; b > 0; --b) {
+    hash.bucketStart[b] = hash.bucketStart[b - 1];
+  }
+  hash.bucketStart[0] = 0;
+  if ((int)hash.stamp.size() <= maxId) hash.stamp.resize(maxId + 1, hash.query);
+}
+
+// Ids whose cells rect touches, ascending and without duplicates, in
+// hash.found. They are candidates only; callers test the actual overlap.
+ArenaVector<int> const &queryHash(SpatialHash &hash, Rectangle rect) {
+  hash.found.clear();
+  if (hash.entries.empty()) return hash.found;
+  hash.query++;
+  TileRange r = hashCells(rect);
+  for (int cy = r.top; cy <= r.bottom; ++cy) {
+    for (int cx = r.left; cx <= r.right; ++cx) {
+      int b = hashBucket(cx, cy);
+      for (int k = hash.bucketStart[b]; k < hash.bucketStart[b + 1]; ++k) {
+        int id = hash.entries[k];
+        if (hash.stamp[id] == hash.query) continue;
+        hash.stamp[id] = hash.query;
+        hash.found.push_back(id);
+      }
+    }
+  }
+  std::sort(hash.found.begin(), hash.found.end());
+  return hash.found;
+}
+
+// Grid of the living players, for the projectile and grenade passes.
+void buildPlayerHash(SpatialHash &hash, std::vector<Player> const &players) {
+  clearHash(hash);
+  for (int i = 0; i < (int)players.size(); i++) {
+    Player const &pl = players[i];
+    if (!hasFlag(pl.status_flags, ALIVE)) continue;
+    insertHash(hash, i, {pl.x, pl.y, pl.w, pl.h});
+  }
+  finishHash(hash);
+}
+
+Rectangle pickupBounds(Pickup const &p) {
+    return {p.position.x - p.w / 2.0f, p.position.y - p.h / 2.0f, (float)p.w, (float)p.h};
+}
+
+// Grid of the active pickups by slot index.
+void buildPickupHash(SpatialHash &hash, PickupPool const &pickups) {
+  clearHash(hash);
+  forEachItem(pickups, [&](Pickup const &p, Handle handle) {
+    if (p.active) insertHash(hash, handle.index, pickupBounds(p));
+  });
+  finishHash(hash);
+}
+
+// Moves the player one axis at a time, stopping flush against the first tile
+// in the way, so fast movement can neither tunnel through nor hover short
+// of a wall.
+void handlePlayerCollision(Player &player, GameMap const &currentMap, float const dt) {
+  float move_x = player.dx * dt;
+  if (move_x != 0.0f) {
+    Rectangle box = {player.x, player.y, player.w, player.h};
+    SweepHit hit = sweepMap(currentMap, box, move_x, 0.0f, false);
+    if (hit.hit) {
+      float travel = std::max(0.0f, hit.t * fabsf(move_x) - SWEEP_SKIN);
+      player.x += copysignf(travel, move_x);
+      player.dx = 0.0f;
+    } else {
+      player.x += move_x;
+    }
+  }
+  float move_y = player.dy * dt;
+  SweepHit hit;
+  if (move_y != 0.0f) {
+    Rectangle box = {player.x, player.y, player.w, player.h};
+    hit = sweepMap(currentMap, box, 0.0f, move_y, false);
+  }
+  if (hit.hit) {
+    float travel = std::max(0.0f, hit.t * fabsf(move_y) - SWEEP_SKIN);
+    player.y += copysignf(travel, move_y);
+    player.dy = 0.0f;
+    if (move_y > 0.0f) {
+      setFlag(player.status_flags, GROUNDED);
+      clearFlag(player.status_flags, JUMPING);
+    }
+  } else {
+    player.y += move_y;
+    clearFlag(player.status_flags, GROUNDED);
+  }
+}
+
+
+// Minimum distance findValidSpawn tries to keep between a new spawn and the
+// spots passed in to avoid.
+float const MIN_SPAWN_DISTANCE = 4.0f * TILE_SIZE;
+int const SPAWN_TRIES = 8;
+
+// Picks a spawn from the map's index. Up to SPAWN_TRIES random spawns are
+// tried for one at least MIN_SPAWN_DISTANCE from every point in avoid; if
+// none is, the one farthest from its nearest avoided point wins.
+Vector2 findValidSpawn(const GameMap &map, Rng &rng,
+                       ArenaVector<Vector2> const &avoid = {}) {
+    int count = (int)map.spawns.size();
+    if (count == 0) return {0, 0};
+
+    Vector2 best = {0, 0};
+    float bestDistance = -1.0f;
+    int tries = avoid.empty() ? 1 : SPAWN_TRIES;
+    for (int attempt = 0; attempt < tries; ++attempt) {
+        Vector2 pick = map.spawns[randomRange(rng, 0, count - 1)];
+        float nearest = FLT_MAX;
+        for (Vector2 other : avoid) {
+            nearest = std::min(nearest, Vector2Distance(pick, other));
+        }
+        if (nearest >= MIN_SPAWN_DISTANCE) return pick;
+        if (nearest > bestDistance) {
+            best = pick;
+            bestDistance = nearest;
+        }
+    }
+    return best;
+}
+
+
+void handlePlayerInput(Player &player, float dt, GameMap const &currentMap) {
+	bool left  = isActionDown(player.controls, ACTION_LEFT);
+	bool right = isActionDown(player.controls, ACTION_RIGHT);
+  
+	float accel_mod = (hasFlag(player.status_flags, DUCKING) &&
+                     hasFlag(player.status_flags, GROUNDED))
+                        ? 0.2f
+                        : 1.0f;
+  if (!hasFlag(player.status_flags, SLIDING)) {
+    if (left) {
+      player.dx -= player.accel * dt;
+      player.facing = -1;
+    }
+    if (right) {
+      player.dx += player.accel * dt;
+      player.facing = 1;
+    }
+    if (!left && !right) {
+      if (std::fabs(player.dx) < 0.05f)
+        player.dx = 0.0f;
+      else
+        player.dx *= (1.0f - player.drag * dt);
+    }
+  } else {
+    float const sliding_drag_reduction = 0.2f;
+    player.dx *= (1.0f - player.drag * sliding_drag_reduction * dt);
+  }
+
+  player.dx =
+      std::clamp(player.dx, -player.max_vel, player.max_vel * accel_mod);
+	
+	if (isActionDown(player.controls, ACTION_JUMP) && hasFlag(player.status_flags, GROUNDED)) {
+	    player.dy = -player.jump_force;
+	    clearFlag(player.status_flags, GROUNDED);
+	    setFlag(player.status_flags, JUMPING);
+	}
+
+  if (isActionReleased(player.controls, ACTION_JUMP) && player.dy < -player.jump_force * 0.5f) {
+    player.dy *= 0.5f; 
+  }
+
+  if (isActionPressed(player.controls, ACTION_DASH) && !hasFlag(player.status_flags, DASHING)) {
+    setFlag(player.status_flags, DASHING);
+    player.dash_timer = player.dash_duration;
+
+    int dir = player.facing;
+    if (left)
+      dir = -1;
+    if (right)
+      dir = 1;
+
+    player.dx = dir * player.dash_speed;
+  }
+  if (hasFlag(player.status_flags, DASHING)) {
+    player.dash_timer -= dt;
+    if (player.dash_timer <= 0.0f) {
+      clearFlag(player.status_flags, DASHING);
+      if (std::fabs(player.dx) > player.max_vel) {
+        player.dx = (player.dx > 0 ? player.max_vel : -player.max_vel);
+      }
+    }
+  }
+
+  float const sliding_threshold = 20.0f;
+  if (isActionDown(player.controls, ACTION_DOWN)) {
+    if (hasFlag(player.status_flags, GROUNDED)) {
+      if (!hasFlag(player.status_flags, SLIDING) &&
+          std::fabs(player.dx) > sliding_threshold) {
+        setFlag(player.status_flags, SLIDING);
+        float new_h = player.original_h * player.duck_scale;
+        player.y += (player.h - new_h);
+        player.h = new_h;
+        player.slide_timer = player.slide_duration;
+      }
+    }
+    if (!hasFlag(player.status_flags, SLIDING) &&
+        !hasFlag(player.status_flags, DUCKING)) {
+      setFlag(player.status_flags, DUCKING);
+      float new_h = player.original_h * player.duck_scale;
+      player.y += (player.h - new_h);
+      player.h = new_h;
+    }
+  } else {
+    float old_h = player.h;
+    float new_h = player.original_h;
+    float diff = new_h - old_h;
+
+    Player test = player;
+    test.y -= diff;
+    test.h = new_h;
+
+    if (!hasMapCollision(currentMap, test)) {
+      clearFlag(player.status_flags, DUCKING);
+      clearFlag(player.status_flags, SLIDING);
+      player.y -= diff;
+      player.h = new_h;
+    } else {
+      setFlag(player.status_flags, DUCKING);
+    }
+  }
+
+  if (hasFlag(player.status_flags, SLIDING)) {
+    player.slide_timer -= dt;
+
+    if (player.slide_timer <= 0.0f || std::fabs(player.dx) < 30.0f) {
+      clearFlag(player.status_flags, SLIDING);
+    }
+  }
+
+  if (!hasFlag(player.status_flags, GROUNDED)) {
+    player.dy += player.gravity * dt;
+  }
+
+  if (std::fabs(player.dx) < 0.001f)
+    player.dx = 0.0f;
+  if (std::fabs(player.dy) < 0.001f)
+    player.dy = 0.0f;
+}
+
+void handleGunPickups(Player &player, GunPool &guns, WeaponTable const &weapons) {
+  if (!isNull(player.gun)) {
+		return;
+	}
+	Rectangle playerRect = {player.x, player.y, player.w, player.h};
+  for (int slot = 0; slot < guns.used; ++slot) {
+    Gun &gun = guns.items[slot];
+    if (guns.live[slot] && !gun.picked_up) {
+      GunArchetype const &kind = gunArchetype(weapons, gun);
+      Rectangle gunRect = {gun.x, gun.y, kind.w, kind.h};
+      if (CheckCollisionRecs(playerRect, gunRect)) {
+        gun.picked_up = true;
+        player.gun = Handle{(uint16_t)slot, guns.generation[slot]};
+        break;
+      }
+    }
+  }
+}
+
+void handleShooting(Player &player, GunPool &guns, WeaponTable const &weapons,
+                    ProjectilePool &projectiles, Rng &rng, float dt) {
+  Gun *gun = getItem(guns, player.gun);
+  if (!gun) {
+    return;
+  }
+	if (gun->ammo <= 0) {
+		destroyItem(guns, player.gun);
+		player.gun = Handle{};
+		return;
+	}
+
+  if (gun->cooldown > 0.0f) {
+    gun->cooldown -= dt;
+  }
+
+  GunArchetype const &kind = gunArchetype(weapons, *gun);
+  if (isActionDown(player.controls, ACTION_FIRE) && gun->ammo > 0 && gun->cooldown <= 0.0f) {
+    gun->cooldown = 1.0f / kind.fire_rate;
+    gun->ammo--;
+
+    float baseAngle = (player.facing == -1) ? M_PI : 0.0f;
+    float speed_factor = std::min(1.0f, std::fabs(player.dx) / player.max_vel);
+    float jump_factor = hasFlag(player.status_flags, GROUNDED) ? 0.0f : 2.5f;
+    float spread_angle = kind.spread * (1.0f + speed_factor + jump_factor);
+    float angle = baseAngle + (randomFloat(rng) - 0.5f) * spread_angle;
+
+    float vx = cosf(angle) * kind.projectile_speed;
+    float vy = sinf(angle) * kind.projectile_speed;
+
+    float shoulderY = player.y + player.h * 0.30f;
+    float shoulderX = (player.facing == 1) ? player.x + player.w : player.x;
+
+    float projX = shoulderX;
+    float projY = shoulderY;
+
+    if (player.facing == 1) {
+      projX += 5.0f;
+    } else {
+      projX -= 5.0f;
+    }
+
+    spawnProjectile(projectiles, projX, projY, vx, vy, kind.range, player.id);
+  }
+}
+
+
+void handleGrenadeThrow(Player &player, GrenadePool &grenades, GrenadeParams const &params) {
+    if (isActionPressed(player.controls, ACTION_GRENADE) && player.grenadeCount > 0) {
+        Grenade g;
+        g.radius = params.radius;
+        g.fuse = params.fuse;
+        g.bounce = params.bounce;
+        g.trail = {};
+        g.exploded = false;
+
+        float throwSpeed = params.throw_speed;
+        float throwAngle = (player.facing == 1) ? -M_PI / 5.0f : M_PI + M_PI / 5.0f; 
+        g.dx = cosf(throwAngle) * throwSpeed + player.dx * 0.5f; 
+        g.dy = sinf(throwAngle) * throwSpeed + player.dy * 0.5f;
+
+        g.x = player.x + player.w / 2 + (player.facing * 40.0f);
+        g.y = player.y + player.h * 0.4f;
+        g.prev_x = g.x;
+        g.prev_y = g.y;
+
+        if (!isNull(createItem(grenades, g))) {
+            player.grenadeCount--; // Consume one grenade
+        }
+    }
+}
+
+
+// Chunks around the living players that items are placed in, so a large
+// map only has things happening where someone can reach them. Maps up to
+// ACTIVE_MARGIN_CHUNKS chunks across are always covered whole.
+int const ACTIVE_MARGIN_CHUNKS = 2;
+
+TileRange activeTiles(GameMap const &map, std::vector<Player> const &players) {
+    TileRange r = {map.width, map.height, -1, -1};
+    for (Player const &pl : players) {
+        if (!hasFlag(pl.status_flags, ALIVE)) continue;
+        TileRange p = tilesOverlapping(map, {pl.x, pl.y, pl.w, pl.h});
+        r = {std::min(r.left, p.left), std::min(r.top, p.top),
+             std::max(r.right, p.right), std::max(r.bottom, p.bottom)};
+    }
+    if (r.right < r.left) return {0, 0, map.width - 1, map.height - 1};
+    int margin = ACTIVE_MARGIN_CHUNKS * MAP_CHUNK_TILES;
+    return {std::clamp(r.left - margin, 0, map.width - 1),
+            std::clamp(r.top - margin, 0, map.height - 1),
+            std::clamp(r.right + margin, 0, map.width - 1),
+            std::clamp(r.bottom + margin, 0, map.height - 1)};
+}
+
+// A fresh gun placed inside a random empty tile of area, so it never
+// overlaps the map. Guns fit within one tile. freeTiles is
+// countFreeTiles(map, area) and must not be zero.
+// The kind is drawn first, and only when there is more than one to choose
+// from.
+Gun spawnRandomGun(GameMap const &map, WeaponTable const &weapons, TileRange area,
+                   int freeTiles, Rng &rng) {
+    Gun gun = {};
+    int kinds = (int)weapons.guns.size();
+    gun.archetype = (uint8_t)(kinds > 1 ? randomRange(rng, 0, kinds - 1) : 0);
+    GunArchetype const &kind = weapons.guns[gun.archetype];
+    gun.ammo = kind.ammo;
+    gun.picked_up = false;
+    gun.cooldown = 0.0f;
+
+    int cell = nthFreeTile(map, area, randomRange(rng, 0, freeTiles - 1));
+    gun.x = (float)(cell % map.width * TILE_SIZE + randomRange(rng, 0, TILE_SIZE - (int)kind.w));
+    gun.y = (float)(cell / map.width * TILE_SIZE + randomRange(rng, 0, TILE_SIZE - (int)kind.h));
+    return gun;
+}
+
+
+// Each bullet is swept along its whole step against the map and the living
+// players; whichever it reaches first is hit and the bullet stops there.
+// playerGrid must hold the players, from buildPlayerHash.
+void updateProjectiles(ProjectilePool &p, float dt, GameMap const &map,
+                       std::vector<Player> &players, SpatialHash &playerGrid) {
+  for (int i = 0; i < p.count;) {
+    float move_x = p.dx[i] * dt;
+    float move_y = p.dy[i] * dt;
+    Rectangle rect = {p.x[i], p.y[i], 8, 8};
+
+    SweepHit wall = sweepMap(map, rect, move_x, move_y, true);
+    float t = wall.hit ? wall.t : 1.0f;
+    Player *target = nullptr;
+    Rectangle swept = {std::min(rect.x, rect.x + move_x), std::min(rect.y, rect.y + move_y),
+                       rect.width + fabsf(move_x), rect.height + fabsf(move_y)};
+    for (int id : queryHash(playerGrid, swept)) {
+      Player &pl = players[id];
+      // Left-facing shots start inside their shooter's box.
+      if (id == p.ownerId[i] || !(hasFlag(pl.status_flags, ALIVE))) continue;
+
+      Rectangle prect = {pl.x, pl.y, pl.w, pl.h};
+      SweepHit hit = sweepRect(rect, move_x, move_y, prect);
+      if (hit.hit && (hit.t < t || (!wall.hit && !target))) {
+        t = hit.t;
+        target = &pl;
+      }
+    }
+
+    p.x[i] += move_x * t;
+    p.y[i] += move_y * t;
+		pushTrail(p.trail[i], {p.x[i], p.y[i]});
+    p.traveled[i] += sqrtf(move_x * move_x + move_y * move_y) * t;
+
+    bool remove = wall.hit || p.traveled[i] >= p.max_distance[i];
+    if (target) {
+      target->health -= 25;
+      target->hitTimer = 0.2f;
+      if (target->health <= 0) {
+        clearFlag(target->status_flags, ALIVE);
+        target->respawnTimer = 3.0f;
+        if (p.ownerId[i] >= 0) players[p.ownerId[i]].kills++;
+      }
+      remove = true;
+    }
+    if (remove) {
+      removeProjectile(p, i);
+    } else {
+      i++;
+    }
+  }
+}
+
+
+void updateGrenades(GrenadePool &grenades, float dt,
+                    const GameMap &map, std::vector<Player> &players,
+                    SpatialHash &playerGrid, ProjectilePool &projectiles,
+                    GrenadeParams const &params) {
+    const float gravity = 1500.0f;
+    const float EPS = 0.1f;       
+    const float FLOOR_EPS = 2.0f; 
+    const float MIN_BOUNCE_SPEED = 60.0f;
+
+    forEachItem(grenades, [&](Grenade &g, Handle handle) {
+
+        pushTrail(g.trail, {g.x, g.y});
+
+        g.fuse -= dt;
+        if (g.fuse <= 0.0f && !g.exploded) {
+            g.exploded = true;
+
+            int numProjectiles = params.shrapnel;
+            float speed = params.shrapnel_speed;
+            for (int j = 0; j < numProjectiles; ++j) {
+                float angle = j * (2 * M_PI / numProjectiles);
+                spawnProjectile(
+                    projectiles,
+                    g.x, g.y,
+                    cosf(angle) * speed,
+                    sinf(angle) * speed,
+                    params.shrapnel_range,
+                    -1
+                );
+            }
+        }
+        if (g.exploded) {
+            destroyItem(grenades, handle);
+            return;
+        }
+        g.dy += gravity * dt;
+
+        float nextX = g.x + g.dx * dt;
+        float nextY = g.y + g.dy * dt;
+
+        Rectangle nextRect = {nextX - g.radius, nextY - g.radius, g.radius * 2, g.radius * 2};
+
+        bool grounded = false;
+
+        forEachSolidTile(map, nextRect, [&](Rectangle tile) {
+            if (CheckCollisionRecs(nextRect, tile)) {
+                if (g.dy > 0 && g.y + g.radius <= tile.y + FLOOR_EPS) {
+                    grounded = true;
+                    nextY = tile.y - g.radius;
+                    g.dy *= -g.bounce;
+
+                    if (fabs(g.dy) < MIN_BOUNCE_SPEED) g.dy = 0;
+                }
+                else if (g.dy < 0 && g.y - g.radius >= tile.y + TILE_SIZE - FLOOR_EPS) {
+                    nextY = tile.y + TILE_SIZE + g.radius;
+                    g.dy *= -g.bounce;
+                }
+            }
+        });
+
+        Rectangle horizRect = {nextX - g.radius, g.y - g.radius, g.radius * 2, g.radius * 2};
+        forEachSolidTile(map, horizRect, [&](Rectangle tile) {
+            if (CheckCollisionRecs(horizRect, tile)) {
+                if (g.dx > 0 && g.x + g.radius <= tile.x + EPS) {
+                    nextX = tile.x - g.radius;
+                    g.dx *= -g.bounce;
+                } else if (g.dx < 0 && g.x - g.radius >= tile.x + TILE_SIZE - EPS) {
+                    nextX = tile.x + TILE_SIZE + g.radius;
+                    g.dx *= -g.bounce;
+                }
+            }
+        });
+        g.x = nextX;
+        g.y = nextY;
+        g.dx *= 0.98f;
+
+        if (grounded && fabs(g.dy) < 0.1f && fabs(g.dx) < 5.0f)
+      	{
+						g.dy = g.dx = 0;
+				}
+
+				// Pushing off one player moves the grenade by less than its radius,
+				// so the players it can reach afterwards are within twice that.
+				Rectangle reach = {g.x - 2 * g.radius, g.y - 2 * g.radius, g.radius * 4, g.radius * 4};
+				for (int id : queryHash(playerGrid, reach)) {
+    			Player &pl = players[id];
+    			if (!hasFlag(pl.status_flags, ALIVE)) continue;
+
+    			Rectangle prect = {pl.x, pl.y, pl.w, pl.h};
+
+    			if (CheckCollisionCircleRec({g.x, g.y}, g.radius, prect)) {
+    			    float closestX = std::clamp(g.x, prect.x, prect.x + prect.width);
+    			    float closestY = std::clamp(g.y, prect.y, prect.y + prect.height);
+
+    			    float dx = g.x - closestX;
+    			    float dy = g.y - closestY;
+    			    float dist2 = dx * dx + dy * dy;
+
+    			    if (dist2 < g.radius * g.radius && dist2 > 0.0001f) {
+    			        float dist = sqrtf(dist2);
+    			        float overlap = g.radius - dist;
+
+    			        dx /= dist;
+    			        dy /= dist;
+
+    			        g.x += dx * overlap;
+    			        g.y += dy * overlap;
+
+    			        float vn = g.dx * dx + g.dy * dy;
+    			        if (vn < 0) { 
+    			            g.dx -= (1 + g.bounce) * vn * dx;
+    			            g.dy -= (1 + g.bounce) * vn * dy;
+    			        }
+    			        g.dx += pl.dx * 0.2f;
+    			        g.dy += pl.dy * 0.2f;
+    			        g.dx *= 0.98f;
+    			        g.dy *= 0.98f;
+    			    }
+    				}
+					}
+    });
+}
+
+
+void TryInteract(Player &player, PickupPool &pickups, GunPool &guns, WeaponTable const &weapons)
+{
+    if (!player.canInteract) return;
+
+    Pickup *nearby = getItem(pickups, player.nearbyPickup);
+    if (!nearby || !nearby->active) return;
+    Pickup &p = *nearby;
+
+    switch (p.type)
+    {
+        case GUN:
+        {
+            Gun *newGun = getItem(guns, p.gun);
+            if (!newGun) break;
+
+            // If player already has a gun, drop it first
+            if (Gun *held = getItem(guns, player.gun))
+            {
+                // Create pickup for current gun
+                Pickup dropped;
+                dropped.type = GUN;
+                dropped.position = { player.x + player.w/2, player.y + player.h/2 };
+                dropped.active = true;
+                dropped.gun = player.gun;
+                dropped.w = gunArchetype(weapons, *held).w;
+                dropped.h = gunArchetype(weapons, *held).h;
+                
+                // No room to drop it, so keep it.
+                if (isNull(createItem(pickups, dropped))) break;
+                held->picked_up = false;
+            }
+
+            // Pick up the new gun
+            newGun->picked_up = true;
+            player.gun = p.gun;
+            p.active = false;
+            break;
+        }
+
+        case GRENADE:
+        {
+            if (player.grenadeCount < player.maxGrenades)
+            {
+                player.grenadeCount = std::min(
+                    player.grenadeCount + p.grenadeAmount,
+                    player.maxGrenades
+                );
+                p.active = false;
+            }
+            break;
+        }
+    }
+    
+    // Reset interaction state
+    player.nearbyPickup = Handle{};
+    player.canInteract = false;
+}
+
+
+void SpawnPickup(PickupPool &pickups, Vector2 pos, PickupType type, Handle gun = Handle{})
+{
+    Pickup p;
+    p.type = type;
+    p.position = pos;
+    p.active = true;
+    p.gun = gun;
+    createItem(pickups, p);
+}
+
+
+// Skipped when either pool is full or area has no room; the next spawn
+// timer tries again.
+void SpawnGunWithPickup(GunPool &guns, PickupPool &pickups, WeaponTable const &weapons,
+                        const GameMap &map, TileRange area, Rng &rng) {
+    if (guns.count == MAX_GUNS || pickups.count == MAX_PICKUPS) return;
+    int freeTiles = countFreeTiles(map, area);
+    if (freeTiles == 0) {
+        TraceLog(LOG_WARNING, "No free tile to spawn a gun in!");
+        return;
+    }
+    Gun gun = spawnRandomGun(map, weapons, area, freeTiles, rng);
+    GunArchetype const &kind = weapons.guns[gun.archetype];
+    Handle handle = createItem(guns, gun);
+
+		Pickup p;
+		p.type = GUN;
+		p.position = {gun.x + kind.w / 2, gun.y + kind.h / 2};
+		p.active = true;
+		p.gun = handle;
+		
+		p.w = kind.w;
+		p.h = kind.h;
+		
+		createItem(pickups, p);
+}
+
+
+
+
+
+Player initPlayer(GameMap const &currentMap, Rng &rng,
+                  ArenaVector<Vector2> const &avoid = {}) {
+  Player player = {};
+  player.w = PLAYER_W;
+  player.h = PLAYER_H;
+  Vector2 spawn = findValidSpawn(currentMap, rng, avoid);
+	player.x = player.prev_x = spawn.x;
+	player.y = player.prev_y = spawn.y;
+  player.original_h = player.h;
+  player.dx = 0.0f;
+  player.dy = 0.0f;
+  player.max_vel = 300.0f;
+
+  player.accel = 1200.0f;
+  player.drag = 6.0f;
+  player.gravity = 2000.0f;
+  player.jump_force = 1000.0f;
+
+  player.dash_speed = 3000.0f;
+  player.dash_duration = 1.00;
+  player.slide_duration = 0.5f;
+  player.duck_scale = 0.3f;
+
+  player.dash_timer = 0.0f;
+  player.slide_timer = 0.0f;
+
+  player.facing = 1;
+
+  player.status_flags = 0;
+  setFlag(player.status_flags, GROUNDED);
+	
+	player.max_health = 100;
+	player.health = player.max_health;
+  setFlag(player.status_flags, ALIVE);
+
+  return player;
+}
+
+void resetPlayer(Player &player, GameMap const &currentMap, Rng &rng,
+                 ArenaVector<Vector2> const &avoid = {}) {
+		player.dx = 0.0f;
+    player.dy = 0.0f;
+
+    player.w = PLAYER_W;
+    player.h = PLAYER_H;
+    player.original_h = player.h;
+
+		Vector2 spawn = findValidSpawn(currentMap, rng, avoid);
+    player.x = player.prev_x = spawn.x;
+    player.y = player.prev_y = spawn.y;
+    
+    player.dash_timer = 0.0f;
+    player.slide_timer = 0.0f;
+    player.facing = 1;
+
+    player.health = player.max_health;
+    player.hitTimer = 0.0f;
+    player.respawnTimer = 0.0f;
+
+    player.gun = Handle{};
+
+    player.status_flags = 0;
+    setFlag(player.status_flags, GROUNDED);
+    setFlag(player.status_flags, ALIVE);
+}
+
+
+// Checked when the current round ends. A match lasts totalRounds rounds and
+// ends early once one player has won a majority of them, which with more
+// than two players may never happen.
+bool isMatchOver(const MatchInfo &match) {
+    if (match.currentRound >= match.totalRounds) return true;
+    int majority = match.totalRounds / 2 + 1;
+    for (int won : match.wins) {
+        if (won >= majority) return true;
+    }
+    return false;
+}
+
+// The player with the most round wins, or -1 when the lead is shared.
+int matchWinner(const MatchInfo &match) {
+    int winner = -1;
+    bool shared = false;
+    for (int i = 0; i < (int)match.wins.size(); i++) {
+        if (winner < 0 || match.wins[i] > match.wins[winner]) {
+            winner = i;
+            shared = false;
+        } else if (match.wins[i] == match.wins[winner]) {
+            shared = true;
+        }
+    }
+    return shared ? -1 : winner;
+}
+
+const char *const WEAPONS_FILE = "resources/weapons.txt";
+
+// The stats the game shipped with, used when there is no weapon file.
+WeaponsRef builtinWeapons() {
+    static WeaponsRef builtin = [] {
+        WeaponTable table;
+        table.guns.push_back({"rifle", 60, 30, 30, 5.0f, 800.0f, 0.15f, 600.0f});
+        table.grenade = {12.0f, 2.5f, 0.8f, 700.0f, 16, 600.0f, 400.0f};
+        return std::make_shared<WeaponTable const>(table);
+    }();
+    return builtin;
+}
+
+// Weapon files are "[gun NAME]" and "[grenade]" sections of "key = value"
+// lines; '#' starts a comment. Keys left out keep the built-in values.
+bool parseWeaponTable(std::string const &path, WeaponTable &table) {
+    FILE *file = fopen(path.c_str(), "r");
+    if (!file) {
+        TraceLog(LOG_ERROR, "Failed to open weapon file: %s", path.c_str());
+        return false;
+    }
+    WeaponTable const &builtin = *builtinWeapons();
+    table.guns.clear();
+    table.grenade = builtin.grenade;
+
+    enum { NONE, GUN_SECTION, GRENADE_SECTION } section = NONE;
+    char line[256];
+    int lineNumber = 0;
+    const char *error = nullptr;
+    while (!error && fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        if (char *comment = strchr(line, '#')) *comment = '\0';
+        std::string text = line;
+        text.erase(0, text.find_first_not_of(" \t\r\n"));
+        text.erase(text.find_last_not_of(" \t\r\n") + 1);
+        if (text.empty()) continue;
+        char key[64];
+        float value;
+        char rest;
+
+        if (text.compare(0, 5, "[gun ") == 0 && text.back() == ']') {
+            if (table.guns.size() == MAX_GUN_ARCHETYPES) {
+                error = "too many guns";
+                break;
+            }
+            GunArchetype gun = builtin.guns[0];
+            snprintf(gun.name, sizeof(gun.name), "%s", text.substr(5, text.size() - 6).c_str());
+            table.guns.push_back(gun);
+            section = GUN_SECTION;
+        } else if (text == "[grenade]") {
+            section = GRENADE_SECTION;
+        } else if (sscanf(text.c_str(), "%63[a-z_] = %f %c", key, &value, &rest) != 2) {
+            error = "expected \"key = number\" or a section header";
+        } else if (section == GUN_SECTION) {
+            GunArchetype &gun = table.guns.back();
+            std::string k = key;
+            if (k == "width") gun.w = value;
+            else if (k == "height") gun.h = value;
+            else if (k == "ammo") gun.ammo = (int)value;
+            else if (k == "fire_rate") gun.fire_rate = value;
+            else if (k == "projectile_speed") gun.projectile_speed = value;
+            else if (k == "spread") gun.spread = value;
+            else if (k == "range") gun.range = value;
+            else error = "unknown gun key";
+            if (!error && (gun.w <= 0 || gun.h <= 0 || gun.w > TILE_SIZE || gun.h > TILE_SIZE)) {
+                error = "gun size must be within one tile";
+            } else if (!error && (gun.ammo <= 0 || gun.fire_rate <= 0 || gun.spread < 0 ||
+                                  gun.projectile_speed <= 0 || gun.range <= 0)) {
+                error = "gun stats must be positive";
+            }
+        } else if (section == GRENADE_SECTION) {
+            GrenadeParams &g = table.grenade;
+            std::string k = key;
+            if (k == "radius") g.radius = value;
+            else if (k == "fuse") g.fuse = value;
+            else if (k == "bounce") g.bounce = value;
+            else if (k == "throw_speed") g.throw_speed = value;
+            else if (k == "shrapnel") g.shrapnel = (int)value;
+            else if (k == "shrapnel_speed") g.shrapnel_speed = value;
+            else if (k == "shrapnel_range") g.shrapnel_range = value;
+            else error = "unknown grenade key";
+            if (!error && (g.radius <= 0 || g.fuse < 0 || g.bounce < 0 || g.shrapnel < 0 ||
+                           g.shrapnel > MAX_PROJECTILES)) {
+                error = "grenade value out of range";
+            }
+        } else {
+            error = "value outside of a section";
+        }
+    }
+    fclose(file);
+    if (!error && table.guns.empty()) {
+        error = "no [gun] sections";
+        lineNumber = 0;
+    }
+    if (error) {
+        TraceLog(LOG_ERROR, "%s:%d: %s", path.c_str(), lineNumber, error);
+        return false;
+    }
+    return true;
+}
+
+// The table in path, or the built-in one if it cannot be read.
+WeaponsRef loadWeapons(std::string const &path) {
+    WeaponTable table;
+    if (!parseWeaponTable(path, table)) return builtinWeapons();
+    return std::make_shared<WeaponTable const>(table);
+}
+
+// Two tables with the same hash play the same, so peers can compare them
+// without sending the whole table.
+uint64_t weaponTableHash(WeaponTable const &table) {
+    uint64_t h = FNV_OFFSET;
+    for (GunArchetype const &gun : table.guns) {
+        h = hashBytes(h, gun.name, strnlen(gun.name, sizeof(gun.name)));
+        h = hashValue(h, gun.w);
+        h = hashValue(h, gun.h);
+        h = hashValue(h, gun.ammo);
+        h = hashValue(h, gun.fire_rate);
+        h = hashValue(h, gun.projectile_speed);
+        h = hashValue(h, gun.spread);
+        h = hashValue(h, gun.range);
+    }
+    GrenadeParams const &g = table.grenade;
+    h = hashValue(h, g.radius);
+    h = hashValue(h, g.fuse);
+    h = hashValue(h, g.bounce);
+    h = hashValue(h, g.throw_speed);
+    h = hashValue(h, g.shrapnel);
+    h = hashValue(h, g.shrapnel_speed);
+    h = hashValue(h, g.shrapnel_range);
+    return h;
+}
+
+// Polls a file's modification time; cheap enough to do every frame.
+struct FileWatch {
+    std::string path;
+    time_t mtime = 0;
+};
+
+FileWatch watchFile(std::string const &path) {
+    FileWatch watch;
+    watch.path = path;
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) watch.mtime = st.st_mtime;
+    return watch;
+}
+
+// True once per change to the file.
+bool fileChanged(FileWatch &watch) {
+    struct stat st;
+    if (stat(watch.path.c_str(), &st) != 0 || st.st_mtime == watch.mtime) return false;
+    watch.mtime = st.st_mtime;
+    return true;
+}
+
+// Everything the match loop mutates each tick. Rendering, the camera and
+// device polling live outside so the same state can be stepped headless.
+struct World {
+    // Backs the grids and spawn bookkeeping for one round; declared first so
+    // it outlives them.
+    Arena roundArena;
+    // Shared with the map cache, so snapshots copy a reference, not tiles.
+    MapRef map = emptyMap();
+    WeaponsRef weapons = builtinWeapons();
+    MatchInfo match;
+    std::vector<Player> players;
+    GunPool guns;
+    PickupPool pickups;
+    ProjectilePool projectiles;
+    GrenadePool grenades;
+    float gunSpawnTimer = 0.0f;
+    SpatialHash playerGrid;
+    SpatialHash pickupGrid;
+
+    World() : playerGrid(&roundArena), pickupGrid(&roundArena) {}
+};
+
+std::vector<std::string> defaultMapFiles() {
+    return {
+        "resources/maps/test.map",
+        "resources/maps/test2.map",
+        "resources/maps/test3.map"
+    };
+}
+
+// Every round starts with no guns, bullets or grenades in play and a fresh
+// set of grenade pickups. A gun spawns on the first tick.
+void resetRoundItems(World &world) {
+    clearPool(world.guns);
+    clearPool(world.pickups);
+    world.projectiles.count = 0;
+    clearPool(world.grenades);
+    world.gunSpawnTimer = 0.0f;
+
+    bool marked = false;
+    for (MapMarker const &marker : world.map->markers) {
+        if (marker.type != MARKER_GRENADE) continue;
+        SpawnPickup(world.pickups, {(float)marker.x * TILE_SIZE, (float)marker.y * TILE_SIZE}, GRENADE);
+        marked = true;
+    }
+    if (!marked) {
+        SpawnPickup(world.pickups, {300, 200}, GRENADE);
+        SpawnPickup(world.pickups, {600, 250}, GRENADE);
+    }
+}
+
+// Gives back everything the last round allocated in one go and switches to
+// the map for the current round, which is normally preloaded by now.
+void loadRoundMap(World &world) {
+    releaseHash(world.playerGrid);
+    releaseHash(world.pickupGrid);
+    resetArena(world.roundArena);
+    world.map = acquireMap(roundMapFile(world.match, world.match.currentRound));
+}
+
+void startNewRound(World &world) {
+    MatchInfo &match = world.match;
+    loadRoundMap(world);
+    resetRoundItems(world);
+
+    ArenaVector<Vector2> taken(ArenaAllocator<Vector2>(&world.roundArena));
+    for (auto &pl : world.players) {
+        resetPlayer(pl, *world.map, match.rng, taken);
+        taken.push_back({pl.x, pl.y});
+    }
+
+    match.state = ROUND_ACTIVE;
+}
+
+// Puts the world into the state at the start of a match. The result only
+// depends on the seed, the map list and the number of players, which is
+// what replays rely on. Player control bindings are kept.
+void startMatch(World &world, uint64_t seed,
+                std::vector<std::string> const &mapFiles = defaultMapFiles()) {
+    world.match = MatchInfo();
+    world.match.mapFiles = mapFiles;
+    world.match.wins.assign(world.players.size(), 0);
+    world.match.seed = seed;
+    seedRng(world.match.rng, seed);
+    for (std::string const &path : mapFiles) preloadMap(path);
+    loadRoundMap(world);
+
+    resetRoundItems(world);
+
+    ArenaVector<Vector2> taken(ArenaAllocator<Vector2>(&world.roundArena));
+    for (int i = 0; i < (int)world.players.size(); i++) {
+        Controls controls = world.players[i].controls;
+        controls.held = 0;
+        controls.prevHeld = 0;
+
+        Player player = initPlayer(*world.map, world.match.rng, taken);
+        taken.push_back({player.x, player.y});
+        player.id = i;
+        player.controls = controls;
+        world.players[i] = player;
+    }
+}
+
+void initWorld(World &world, int playerCount = 2, uint64_t seed = 1,
+               std::vector<std::string> const &mapFiles = defaultMapFiles()) {
+    world.players.assign(playerCount, Player{});
+    for (Player &player : world.players) {
+        player.controls.deviceId = CONTROLS_SCRIPTED;
+    }
+    startMatch(world, seed, mapFiles);
+}
+
+// New match with a seed drawn from the finished one.
+void restartMatch(World &world) {
+    uint64_t seed = ((uint64_t)nextRandom(world.match.rng) << 32) | nextRandom(world.match.rng);
+    std::vector<std::string> mapFiles = world.match.mapFiles;
+    startMatch(world, seed, mapFiles);
+}
+
+// How far, in tiles, a player stuck in an edited map is moved to find open
+// space before falling back to the nearest spawn.
+int const UNSTICK_RADIUS = 8;
+
+bool playerFits(GameMap const &map, Rectangle rect) {
+    return rect.x >= 0.0f && rect.y >= 0.0f &&
+           rect.x + rect.width <= map.width * TILE_SIZE &&
+           rect.y + rect.height <= map.height * TILE_SIZE &&
+           !hasMapCollision(map, rect);
+}
+
+// Moves a player left inside geometry to the closest open spot, searching
+// whole-tile offsets ring by ring.
+void unstickPlayer(Player &player, GameMap const &map) {
+    Rectangle rect = {player.x, player.y, player.w, player.h};
+    if (playerFits(map, rect)) return;
+    Vector2 to = {player.x, player.y};
+    bool found = false;
+    for (int ring = 1; ring <= UNSTICK_RADIUS && !found; ring++) {
+        int best = INT32_MAX;
+        for (int dy = -ring; dy <= ring; dy++) {
+            for (int dx = -ring; dx <= ring; dx++) {
+                if (std::max(abs(dx), abs(dy)) != ring) continue;
+                Rectangle moved = rect;
+                moved.x += dx * TILE_SIZE;
+                moved.y += dy * TILE_SIZE;
+                int distance = dx * dx + dy * dy;
+                if (distance < best && playerFits(map, moved)) {
+                    best = distance;
+                    to = {moved.x, moved.y};
+                    found = true;
+                }
+            }
+        }
+    }
+    if (!found) {
+        float best = FLT_MAX;
+        for (Vector2 spawn : map.spawns) {
+            float distance = Vector2Distance(spawn, {player.x, player.y});
+            if (distance < best) {
+                best = distance;
+                to = spawn;
+            }
+        }
+    }
+    player.x = player.prev_x = to.x;
+    player.y = player.prev_y = to.y;
+    player.dx = 0.0f;
+    player.dy = 0.0f;
+}
+
+// Swaps a reloaded map in under a round that is playing it. Everything else
+// keyed off the tiles is rebuilt per tick, or per map revision by the level
+// cache, so only players caught inside new geometry need fixing up. A peer
+// or a replay would not see the swap, so callers only do this offline.
+void replaceRoundMap(World &world, std::string const &path, MapRef map) {
+    if (world.match.mapFiles.empty() || roundMapFile(world.match, world.match.currentRound) != path) {
+        return;
+    }
+    world.map = map;
+    for (Player &pl : world.players) {
+        if (hasFlag(pl.status_flags, ALIVE)) unstickPlayer(pl, *map);
+    }
+}
+
+// Remembers where everything was before a step so the renderer can
+// interpolate between the last two simulated states.
+void storePreviousPositions(World &world) {
+    for (Player &pl : world.players) {
+        pl.prev_x = pl.x;
+        pl.prev_y = pl.y;
+    }
+    ProjectilePool &p = world.projectiles;
+    std::copy_n(p.x.begin(), p.count, p.prev_x.begin());
+    std::copy_n(p.y.begin(), p.count, p.prev_y.begin());
+    forEachItem(world.grenades, [](Grenade &g, Handle) {
+        g.prev_x = g.x;
+        g.prev_y = g.y;
+    });
+}
+
+// Advances the simulation by one step of dt seconds. Player input must
+// already have been fed into each player's controls.
+void stepWorld(World &world, float dt) {
+    PROFILE_SCOPE("stepWorld");
+    storePreviousPositions(world);
+
+    GameMap const &currentMap = *world.map;
+    MatchInfo &match = world.match;
+    std::vector<Player> &players = world.players;
+    PickupPool &pickups = world.pickups;
+    GunPool &guns = world.guns;
+    WeaponTable const &weapons = *world.weapons;
+
+    // Pickups used up last tick give their slots back. Within a tick they are
+    // only deactivated, so the grid's slot indices stay valid.
+    forEachItem(pickups, [&](Pickup &p, Handle handle) {
+        if (!p.active) destroyItem(pickups, handle);
+    });
+    buildPickupHash(world.pickupGrid, pickups);
+
+    for (Player &player: players) {
+        handlePlayerInput(player, dt, currentMap);
+        handlePlayerCollision(player, currentMap, dt);
+        player.canInteract = false;
+        player.nearbyPickup = Handle{};
+
+        Rectangle playerRect = { player.x, player.y, player.w, player.h };
+
+        for (int slot : queryHash(world.pickupGrid, playerRect)) {
+            Pickup &p = pickups.items[slot];
+            if (p.active && CheckCollisionRecs(playerRect, pickupBounds(p))) {
+                player.canInteract = true;
+                player.nearbyPickup = Handle{(uint16_t)slot, pickups.generation[slot]};
+                break;
+            }
+        }
+        if (player.canInteract &&
+            getItem(pickups, player.nearbyPickup)->type == GRENADE) {
+            TryInteract(player, pickups, guns, weapons);
+        }
+        int pickupCount = pickups.count;
+        if (isActionPressed(player.controls, ACTION_INTERACT) && player.canInteract) {
+            TryInteract(player, pickups, guns, weapons);
+        }
+        // A dropped gun has to be visible to the players after this one.
+        if (pickups.count != pickupCount) {
+            buildPickupHash(world.pickupGrid, pickups);
+        }
+        handleShooting(player, guns, weapons, world.projectiles, match.rng, dt);
+        if (player.grenadeCount > 0) {
+            handleGrenadeThrow(player, world.grenades, weapons.grenade);
+        }
+    }
+    buildPlayerHash(world.playerGrid, players);
+    {
+        PROFILE_SCOPE("updateGrenades");
+        updateGrenades(world.grenades, dt, currentMap, players, world.playerGrid, world.projectiles,
+                       weapons.grenade);
+    }
+    {
+        PROFILE_SCOPE("updateProjectiles");
+        updateProjectiles(world.projectiles, dt, currentMap, players, world.playerGrid);
+    }
+
+    float mapHeight = currentMap.height * TILE_SIZE;
+    int const falloffBuffer = 1000;
+    for (auto &pl : players) {
+        if (hasFlag(pl.status_flags, ALIVE)) {
+            bool fellBelow = (pl.y > mapHeight + falloffBuffer);
+            bool fellLeft = (pl.x + pl.w < -falloffBuffer); 
+
+            if (fellBelow || fellLeft) {
+                clearFlag(pl.status_flags, ALIVE);
+                pl.respawnTimer = 0.0f;
+                pl.health = 0.0f;
+            }
+        }
+    }
+
+    world.gunSpawnTimer -= dt;
+    if (world.gunSpawnTimer <= 0.0f) {
+        SpawnGunWithPickup(guns, pickups, weapons, currentMap, activeTiles(currentMap, players), match.rng);
+        world.gunSpawnTimer = 10.0f; 
+    }
+
+    for (Player &pl : players) {
+        if (pl.hitTimer > 0.0f) pl.hitTimer -= dt;
+    }
+
+    int aliveCount = 0;
+    int alivePlayerId = -1;
+    for (int i = 0; i < (int)players.size(); i++) {
+        if (hasFlag(players[i].status_flags, ALIVE)) {
+            aliveCount++;
+            alivePlayerId = i;
+        }
+    }
+
+    if (match.state == ROUND_ACTIVE) {
+        if (aliveCount <= 1) {
+            match.state = ROUND_OVER;
+            match.roundOverTimer = 3.0f;
+            preloadMap(roundMapFile(match, match.currentRound + 1));
+
+            if (alivePlayerId >= 0) match.wins[alivePlayerId]++;
+        }
+    }
+
+    else if (match.state == ROUND_OVER) {
+        match.roundOverTimer -= dt;
+        if (match.roundOverTimer <= 0.0f) {
+            if (isMatchOver(match)) {
+                match.state = MATCH_OVER;
+            } else {
+                match.currentRound++;
+                startNewRound(world);
+            }
+        }
+    }
+}
+
+// Copies the complete simulation state, used for rollback snapshots. The
+// pools are inline and the vectors keep their capacity across copies, so
+// snapshotting every tick settles into plain memcpy work.
+void copyWorld(World &dst, World const &src) {
+    dst = src;
+}
+
+// FNV-1a over the gameplay-relevant state. Two runs that agree on this after
+// the same number of ticks have simulated the same match.
+uint64_t worldChecksum(World const &world) {
+    uint64_t h = FNV_OFFSET;
+    MatchInfo const &match = world.match;
+    h = hashValue(h, match.currentRound);
+    for (int won : match.wins) h = hashValue(h, won);
+    h = hashValue(h, match.state);
+    h = hashValue(h, match.roundOverTimer);
+    h = hashValue(h, match.rng.state);
+    h = hashValue(h, world.gunSpawnTimer);
+
+    for (Player const &pl : world.players) {
+        h = hashValue(h, pl.x);
+        h = hashValue(h, pl.y);
+        h = hashValue(h, pl.h);
+        h = hashValue(h, pl.dx);
+        h = hashValue(h, pl.dy);
+        h = hashValue(h, pl.health);
+        h = hashValue(h, pl.kills);
+        h = hashValue(h, pl.grenadeCount);
+        h = hashValue(h, pl.status_flags);
+        h = hashValue(h, pl.gun);
+    }
+    forEachItem(world.guns, [&](Gun const &gun, Handle handle) {
+        h = hashValue(h, handle);
+        h = hashValue(h, gun.x);
+        h = hashValue(h, gun.y);
+        h = hashValue(h, gun.ammo);
+        h = hashValue(h, gun.cooldown);
+        h = hashValue(h, gun.picked_up);
+    });
+    forEachItem(world.pickups, [&](Pickup const &p, Handle handle) {
+        h = hashValue(h, handle);
+        h = hashValue(h, p.active);
+        h = hashValue(h, p.gun);
+    });
+    ProjectilePool const &p = world.projectiles;
+    for (int i = 0; i < p.count; i++) {
+        h = hashValue(h, p.x[i]);
+        h = hashValue(h, p.y[i]);
+        h = hashValue(h, p.traveled[i]);
+    }
+    forEachItem(world.grenades, [&](Grenade const &g, Handle) {
+        h = hashValue(h, g.x);
+        h = hashValue(h, g.y);
+        h = hashValue(h, g.fuse);
+    });
+    return h;
+}
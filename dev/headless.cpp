@@ -0,0 +1,339 @@
+#include "raylib.h"
+#include "game.h"
+#include "replay.h"
+#include "net.h"
+#include "bot.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Heap allocations per thread, so a run can show how many the simulation
+// makes outside round setup. Maps preloading on worker threads do not count
+// against the tick that happens to be running.
+static thread_local size_t heapAllocations = 0;
+
+void *operator new(size_t size) {
+  heapAllocations++;
+  void *p = malloc(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+const char *stateName(GameState state) {
+  switch (state) {
+    case ROUND_ACTIVE: return "ROUND_ACTIVE";
+    case ROUND_OVER:   return "ROUND_OVER";
+    case MATCH_OVER:   return "MATCH_OVER";
+  }
+  return "?";
+}
+
+void printMatch(World const &world) {
+  std::string wins;
+  for (int won : world.match.wins) {
+    wins += (wins.empty() ? "" : "-") + std::to_string(won);
+  }
+  printf("  round %d/%d, wins %s, %s, checksum %016llx\n",
+         world.match.currentRound, world.match.totalRounds,
+         wins.c_str(), stateName(world.match.state),
+         (unsigned long long)worldChecksum(world));
+  printf("  live guns %d, pickups %d, grenades %d, bullets %d\n",
+         world.guns.count, world.pickups.count, world.grenades.count,
+         world.projectiles.count);
+}
+
+// Re-simulates a recorded match and checks it ends in the recorded state.
+int runReplay(std::string const &path) {
+  Replay replay;
+  if (!loadReplay(path, replay)) return 1;
+
+  World world;
+  world.weapons = replay.weapons;
+  initWorld(world, replay.playerCount, replay.seed, replay.mapFiles);
+  float const dt = 1.0f / replay.tickRate;
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t run = 0; run < replay.runLengths.size(); run++) {
+    uint16_t const *inputs = &replay.runInputs[run * replay.playerCount];
+    for (uint32_t t = 0; t < replay.runLengths[run]; t++) {
+      for (int i = 0; i < replay.playerCount; i++) {
+        feedControls(world.players[i].controls, inputs[i]);
+      }
+      stepWorld(world, dt);
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  double seconds = std::chrono::duration<double>(end - start).count();
+  double simulated = replay.tickCount * (double)dt;
+  uint64_t checksum = worldChecksum(world);
+  bool match = checksum == replay.finalChecksum;
+
+  printf("replay: %u ticks @ %.0f Hz, seed %llu, in %.3f s (%.1fx real time)\n",
+         replay.tickCount, replay.tickRate, (unsigned long long)replay.seed,
+         seconds, seconds > 0.0 ? simulated / seconds : 0.0);
+  printMatch(world);
+  printf("  %s (expected %016llx)\n", match ? "MATCH" : "MISMATCH",
+         (unsigned long long)replay.finalChecksum);
+  return match ? 0 : 2;
+}
+
+// Fires one shot each way with a target touching the muzzle side and checks
+// the bullet hits the target and not the shooter it starts inside of.
+int runShotCheck() {
+  World world;
+  initWorld(world, 2, 1);
+  int failures = 0;
+  for (int facing : {1, -1}) {
+    Player &shooter = world.players[0];
+    Player &target = world.players[1];
+    shooter.facing = facing;
+    shooter.dx = 0.0f;
+    setFlag(shooter.status_flags, GROUNDED);
+    target.x = facing == 1 ? shooter.x + shooter.w : shooter.x - target.w;
+    target.y = shooter.y;
+    shooter.health = target.health = 100;
+    Gun gun = {shooter.x, shooter.y, 1};
+    gun.picked_up = true;
+    shooter.gun = createItem(world.guns, gun);
+    feedControls(shooter.controls, ACTION_FIRE);
+
+    float const dt = 1.0f / DEFAULT_TICK_RATE;
+    handleShooting(shooter, world.guns, *world.weapons, world.projectiles, world.match.rng, dt);
+    buildPlayerHash(world.playerGrid, world.players);
+    updateProjectiles(world.projectiles, dt, *world.map, world.players, world.playerGrid);
+
+    bool ok = shooter.health == 100 && target.health < 100;
+    printf("shot facing %s: shooter %d, target %d, %s\n", facing == 1 ? "right" : "left",
+           shooter.health, target.health, ok ? "ok" : "FAILED");
+    if (!ok) failures++;
+    clearPool(world.guns);
+    world.projectiles.count = 0;
+  }
+  return failures ? 2 : 0;
+}
+
+struct NetLoopOptions {
+  long long ticks = 6000;
+  float latencyMs = 60.0f;
+  float jitterMs = 20.0f;
+  float lossRate = 0.05f;
+  int inputDelay = 2;
+  int basePort = 47000;
+};
+
+// Two rollback peers in one process talking over localhost UDP, each with
+// its own World. Time is virtual so the run is not paced by the wall clock;
+// the injected latency is applied against that virtual clock.
+int runNetLoop(NetLoopOptions const &opt, float hz, uint64_t seed) {
+  World worlds[2];
+  UdpTransport transports[2];
+  static RollbackSession sessions[2];
+  float const dt = 1.0f / hz;
+
+  for (int i = 0; i < 2; i++) {
+    initWorld(worlds[i], 2, seed);
+    UdpTransport &t = transports[i];
+    if (!openTransport(t, opt.basePort + i, "127.0.0.1", opt.basePort + 1 - i)) {
+      return 1;
+    }
+    t.latencyMs = opt.latencyMs;
+    t.jitterMs = opt.jitterMs;
+    t.lossRate = opt.lossRate;
+    seedRng(t.rng, seed * 2 + i);
+    initSession(sessions[i], worlds[i], t, i, dt, opt.inputDelay);
+  }
+
+  double advanceMs[2] = {0.0, 0.0};
+  double worstAdvanceMs[2] = {0.0, 0.0};
+  long long simulated[2] = {0, 0};
+
+  for (long long frame = 0; frame < opt.ticks; frame++) {
+    double nowMs = frame * 1000.0 / hz;
+    for (int i = 0; i < 2; i++) {
+      RollbackSession &s = sessions[i];
+      uint16_t input = scriptedInput(i, s.tick + s.inputDelay);
+
+      auto start = std::chrono::steady_clock::now();
+      bool advanced = advanceSession(s, input, nowMs);
+      double ms = std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - start).count();
+
+      advanceMs[i] += ms;
+      worstAdvanceMs[i] = std::max(worstAdvanceMs[i], ms);
+      simulated[i] += s.lastResimulated + (advanced ? 1 : 0);
+    }
+  }
+
+  int desyncs = 0;
+  int compared = 0;
+  printf("netloop: %lld frames @ %.0f Hz, latency %.0f+%.0f ms, loss %.0f%%, input delay %d\n",
+         opt.ticks, hz, opt.latencyMs, opt.jitterMs, opt.lossRate * 100.0f, opt.inputDelay);
+  for (int i = 0; i < 2; i++) {
+    RollbackSession const &s = sessions[i];
+    UdpTransport const &t = transports[i];
+    double tickUs = simulated[i] > 0 ? advanceMs[i] * 1000.0 / simulated[i] : 0.0;
+    printf("  peer %d: tick %u, confirmed %u, rollbacks %d (%d ticks, max %d per frame), stalls %d\n",
+           i, s.tick, s.remoteConfirmed, s.rollbacks, s.resimulatedTicks, s.maxResimulated, s.stalls);
+    printf("          packets sent %d, dropped %d, received %d\n", t.sent, t.dropped, t.received);
+    printf("          %.2f us per simulated tick incl. snapshots, worst frame %.3f ms, checksums %d ok %d\n",
+           tickUs, worstAdvanceMs[i], s.checksumsCompared, s.checksumsCompared - s.desyncs);
+    desyncs += s.desyncs;
+    compared += s.checksumsCompared;
+    closeTransport(transports[i]);
+  }
+
+  bool ok = desyncs == 0 && compared > 0;
+  printf("  %s\n", ok ? "IN SYNC" : (desyncs ? "DESYNC" : "NO CHECKSUMS COMPARED"));
+  return ok ? 0 : 2;
+}
+
+int main(int argc, char **argv) {
+  long long ticks = 100000;
+  float hz = DEFAULT_TICK_RATE;
+  uint64_t seed = 1;
+  std::string recordPath;
+  std::string replayPath;
+  std::vector<std::string> mapFiles;
+  bool netLoop = false;
+  bool checkShots = false;
+  NetLoopOptions net;
+  // Bots added after the two scripted players, as in the game.
+  int botCount = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--ticks") && i + 1 < argc) {
+      ticks = atoll(argv[++i]);
+    } else if (!strcmp(argv[i], "--hz") && i + 1 < argc) {
+      hz = (float)atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = strtoull(argv[++i], nullptr, 10);
+    } else if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+      recordPath = argv[++i];
+    } else if (!strcmp(argv[i], "--map") && i + 1 < argc) {
+      mapFiles.push_back(argv[++i]);
+    } else if (!strcmp(argv[i], "--bots") && i + 1 < argc) {
+      botCount = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--replay") && i + 1 < argc) {
+      replayPath = argv[++i];
+    } else if (!strcmp(argv[i], "--check-shots")) {
+      checkShots = true;
+    } else if (!strcmp(argv[i], "--netloop")) {
+      netLoop = true;
+    } else if (!strcmp(argv[i], "--latency") && i + 1 < argc) {
+      net.latencyMs = (float)atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--jitter") && i + 1 < argc) {
+      net.jitterMs = (float)atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--loss") && i + 1 < argc) {
+      net.lossRate = (float)atof(argv[++i]) / 100.0f;
+    } else if (!strcmp(argv[i], "--delay") && i + 1 < argc) {
+      net.inputDelay = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--port") && i + 1 < argc) {
+      net.basePort = atoi(argv[++i]);
+    } else {
+      fprintf(stderr,
+              "usage: %s [--ticks N] [--hz RATE] [--seed N] [--record FILE] [--map FILE]...\n"
+              "          [--bots N]\n"
+              "       %s --replay FILE\n"
+              "       %s --check-shots\n"
+              "       %s --netloop [--ticks N] [--latency MS] [--jitter MS] [--loss PCT]\n"
+              "                    [--delay TICKS] [--port BASE]\n", argv[0], argv[0], argv[0], argv[0]);
+      return 1;
+    }
+  }
+
+  SetTraceLogLevel(LOG_WARNING);
+
+  if (!replayPath.empty()) {
+    return runReplay(replayPath);
+  }
+  if (checkShots) {
+    return runShotCheck();
+  }
+  if (ticks <= 0 || hz <= 0.0f) {
+    fprintf(stderr, "ticks and hz must be positive\n");
+    return 1;
+  }
+  if (botCount < 0 || 2 + botCount > MAX_PLAYERS) {
+    fprintf(stderr, "bots must be between 0 and %d\n", MAX_PLAYERS - 2);
+    return 1;
+  }
+  if (netLoop) {
+    net.ticks = ticks;
+    return runNetLoop(net, hz, seed);
+  }
+
+  if (mapFiles.empty()) mapFiles = defaultMapFiles();
+
+  World world;
+  world.weapons = loadWeapons(WEAPONS_FILE);
+  initWorld(world, 2 + botCount, seed, mapFiles);
+  std::vector<Bot> bots;
+  initBots(bots, world, seed, 2);
+  float const dt = 1.0f / hz;
+  int matches = 0;
+  double botSeconds = 0.0;
+
+  // A replay covers one match, so recording stops when the match ends.
+  ReplayWriter recorder;
+  if (!recordPath.empty() && !beginReplay(recorder, recordPath, world, hz)) {
+    return 1;
+  }
+
+  // Heap allocations made by ticks that did not start a round or match.
+  size_t steadyAllocations = 0;
+  long long steadyTicks = 0;
+
+  long long tick = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (; tick < ticks; tick++) {
+    for (Player &player : world.players) {
+      if (player.controls.deviceId == CONTROLS_BOT) continue;
+      feedControls(player.controls, scriptedInput(player.id, (uint64_t)tick));
+    }
+    if (botCount) {
+      auto botStart = std::chrono::steady_clock::now();
+      feedBots(bots, world);
+      botSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - botStart).count();
+    }
+    recordTick(recorder, world);
+    int round = world.match.currentRound;
+    size_t allocationsBefore = heapAllocations;
+    stepWorld(world, dt);
+    if (world.match.currentRound == round && world.match.state != MATCH_OVER) {
+      steadyAllocations += heapAllocations - allocationsBefore;
+      steadyTicks++;
+    }
+
+    if (world.match.state == MATCH_OVER) {
+      matches++;
+      if (recorder.file) {
+        tick++;
+        break;
+      }
+      restartMatch(world);
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  endReplay(recorder, world);
+
+  double seconds = std::chrono::duration<double>(end - start).count();
+  double simulated = tick * (double)dt;
+  printf("headless: %lld ticks @ %.0f Hz in %.3f s\n", tick, hz, seconds);
+  printf("  %.0f ticks/s, %.1fx real time\n", tick / seconds, simulated / seconds);
+  printf("  matches finished: %d\n", matches);
+  if (botCount) {
+    printf("  %d bots: %.1f ns per bot per tick\n", botCount, botSeconds * 1e9 / ((double)tick * botCount));
+  }
+  Arena const &arena = world.roundArena;
+  printf("  round arena: peak %zu KiB, this round %zu KiB in %d allocations, %zu blocks\n",
+         arena.peakBytes / 1024, arena.bytes / 1024, arena.allocations, arena.blocks.size());
+  printf("  heap allocations outside round starts: %zu over %lld ticks\n",
+         steadyAllocations, steadyTicks);
+  printMatch(world);
+  return 0;
+}
@@ -0,0 +1,317 @@
+#include "raylib.h"
+#include "game.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Micro-benchmarks for the data layouts in game.h, each run against the
+// layout it replaced. Heap allocations are counted through the global
+// operator new below.
+
+static size_t allocationCount = 0;
+
+void *operator new(size_t size) {
+  allocationCount++;
+  void *p = malloc(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// ---- projectiles ----------------------------------------------------------
+
+// Array-of-structs projectile with a per-bullet trail vector, as it was
+// before ProjectilePool.
+struct LegacyProjectile {
+  float x, y;
+  float dx, dy;
+  float traveled = 0.0f;
+  float max_distance;
+  int ownerId;
+  std::vector<Vector2> trail;
+};
+
+void updateLegacyProjectiles(std::vector<LegacyProjectile> &projectiles, float dt,
+                             GameMap const &map, std::vector<Player> &players) {
+  for (size_t i = 0; i < projectiles.size();) {
+    LegacyProjectile &p = projectiles[i];
+    float move_x = p.dx * dt;
+    float move_y = p.dy * dt;
+    p.x += move_x;
+    p.y += move_y;
+    p.trail.push_back({p.x, p.y});
+    int const max_trail = 30;
+    if (p.trail.size() > max_trail) {
+      p.trail.erase(p.trail.begin());
+    }
+    p.traveled += sqrtf(move_x * move_x + move_y * move_y);
+
+    Rectangle rect = {p.x, p.y, 8, 8};
+    bool remove = false;
+    if (p.traveled >= p.max_distance || hasMapCollision(map, rect)) {
+      remove = true;
+    } else {
+      for (auto &pl : players) {
+        if (!(hasFlag(pl.status_flags, ALIVE))) continue;
+        Rectangle prect = {pl.x, pl.y, pl.w, pl.h};
+        if (CheckCollisionRecs(rect, prect)) {
+          remove = true;
+          break;
+        }
+      }
+    }
+    if (remove) {
+      projectiles[i] = projectiles.back();
+      projectiles.pop_back();
+    } else {
+      i++;
+    }
+  }
+}
+
+struct Direction { float dx, dy; };
+
+Direction randomDirection(Rng &rng) {
+  float angle = randomFloat(rng) * 2.0f * (float)M_PI;
+  return {cosf(angle) * 800.0f, sinf(angle) * 800.0f};
+}
+
+void benchProjectiles(int population, int ticks) {
+  GameMap map;
+  std::vector<Player> players;
+  float const dt = 1.0f / DEFAULT_TICK_RATE;
+  Rng rng;
+
+  // Bullets live for 600 px at 800 px/s, and are topped back up to the
+  // target population every tick, so both layouts see the same churn.
+  seedRng(rng, 1);
+  std::vector<LegacyProjectile> legacy;
+  size_t legacyAllocs = allocationCount;
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < ticks; t++) {
+    while ((int)legacy.size() < population) {
+      Direction d = randomDirection(rng);
+      legacy.push_back({960.0f, 540.0f, d.dx, d.dy, 0.0f, 600.0f, -1});
+    }
+    updateLegacyProjectiles(legacy, dt, map, players);
+  }
+  double legacySeconds = secondsSince(start);
+  legacyAllocs = allocationCount - legacyAllocs;
+
+  seedRng(rng, 1);
+  static ProjectilePool pool;
+  pool.count = 0;
+  SpatialHash playerGrid;
+  buildPlayerHash(playerGrid, players);
+  size_t poolAllocs = allocationCount;
+  start = std::chrono::steady_clock::now();
+  for (int t = 0; t < ticks; t++) {
+    while (pool.count < population) {
+      Direction d = randomDirection(rng);
+      spawnProjectile(pool, 960.0f, 540.0f, d.dx, d.dy, 600.0f, -1);
+    }
+    updateProjectiles(pool, dt, map, players, playerGrid);
+  }
+  double poolSeconds = secondsSince(start);
+  poolAllocs = allocationCount - poolAllocs;
+
+  double updates = (double)population * ticks;
+  printf("  %6d bullets  legacy %7.2f ns/bullet-tick %8.2f allocs/tick"
+         "   pool %7.2f ns/bullet-tick %8.2f allocs/tick   %.2fx\n",
+         population,
+         legacySeconds * 1e9 / updates, legacyAllocs / (double)ticks,
+         poolSeconds * 1e9 / updates, poolAllocs / (double)ticks,
+         legacySeconds / poolSeconds);
+}
+
+// ---- map queries -----------------------------------------------------------
+
+// One enum per tile and one allocation per row, as GameMap was before it was
+// packed into bits.
+using LegacyMap = std::vector<std::vector<Tile>>;
+
+bool legacyMapCollision(LegacyMap const &map, Rectangle rect) {
+  int rows = (int)map.size();
+  int cols = map.empty() ? 0 : (int)map[0].size();
+  int left = std::max(0, (int)std::floor(rect.x / TILE_SIZE));
+  int right = std::min(cols - 1, (int)std::floor((rect.x + rect.width) / TILE_SIZE));
+  int top = std::max(0, (int)std::floor(rect.y / TILE_SIZE));
+  int bottom = std::min(rows - 1, (int)std::floor((rect.y + rect.height) / TILE_SIZE));
+  for (int y = top; y <= bottom; ++y) {
+    for (int x = left; x <= right; ++x) {
+      if (map[y][x] == TILE) {
+        Rectangle tile = {(float)x * TILE_SIZE, (float)y * TILE_SIZE,
+                          (float)TILE_SIZE, (float)TILE_SIZE};
+        if (CheckCollisionRecs(rect, tile)) return true;
+      }
+    }
+  }
+  return false;
+}
+
+void benchMapQueries(int queries) {
+  int const size = 1024;
+  Rng rng;
+  seedRng(rng, 2);
+
+  // Scattered floor runs, sparse enough that most queries have to look at
+  // every tile under them.
+  LegacyMap legacy(size, std::vector<Tile>(size, VOID));
+  GameMap map;
+  resizeMap(map, size, size);
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      if (randomFloat(rng) < 0.02f) {
+        int run = randomRange(rng, 1, 8);
+        for (int i = 0; i < run && x < size; i++, x++) {
+          legacy[y][x] = TILE;
+          setTile(map, x, y, TILE);
+        }
+      }
+    }
+  }
+
+  struct Shape { const char *name; float w, h; };
+  for (Shape shape : {Shape{"bullet", 8, 8}, Shape{"player", 32, 64},
+                      Shape{"gun", 60, 30}, Shape{"area", 512, 512}}) {
+    std::vector<Rectangle> rects(queries);
+    for (Rectangle &r : rects) {
+      r = {randomFloat(rng) * size * TILE_SIZE, randomFloat(rng) * size * TILE_SIZE,
+           shape.w, shape.h};
+    }
+
+    int legacyHits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (Rectangle const &r : rects) legacyHits += legacyMapCollision(legacy, r);
+    double legacySeconds = secondsSince(start);
+
+    int packedHits = 0;
+    start = std::chrono::steady_clock::now();
+    for (Rectangle const &r : rects) packedHits += hasMapCollision(map, r);
+    double packedSeconds = secondsSince(start);
+
+    printf("  %-7s %4.0fx%-4.0f legacy %7.2f ns/query   packed %7.2f ns/query   %.2fx%s\n",
+           shape.name, shape.w, shape.h,
+           legacySeconds * 1e9 / queries, packedSeconds * 1e9 / queries,
+           legacySeconds / packedSeconds,
+           legacyHits == packedHits ? "" : "   HIT COUNTS DIFFER");
+  }
+}
+
+// ---- entity queries -------------------------------------------------------
+
+// Player a bullet's step reaches first, or -1. Tests every player, as
+// updateProjectiles did before the spatial hash.
+int linearTarget(Rectangle rect, float move_x, float move_y, std::vector<Player> const &players) {
+  float t = 2.0f;
+  int target = -1;
+  for (int i = 0; i < (int)players.size(); i++) {
+    Player const &pl = players[i];
+    SweepHit hit = sweepRect(rect, move_x, move_y, {pl.x, pl.y, pl.w, pl.h});
+    if (hit.hit && hit.t < t) {
+      t = hit.t;
+      target = i;
+    }
+  }
+  return target;
+}
+
+int hashedTarget(Rectangle rect, float move_x, float move_y, std::vector<Player> const &players,
+                 SpatialHash &grid) {
+  Rectangle swept = {std::min(rect.x, rect.x + move_x), std::min(rect.y, rect.y + move_y),
+                     rect.width + fabsf(move_x), rect.height + fabsf(move_y)};
+  float t = 2.0f;
+  int target = -1;
+  for (int i : queryHash(grid, swept)) {
+    Player const &pl = players[i];
+    SweepHit hit = sweepRect(rect, move_x, move_y, {pl.x, pl.y, pl.w, pl.h});
+    if (hit.hit && hit.t < t) {
+      t = hit.t;
+      target = i;
+    }
+  }
+  return target;
+}
+
+// Bullets against players spread over a 64x32 tile arena. The hashed side
+// pays for rebuilding the grid every tick, as stepWorld does.
+void benchEntityQueries(int playerCount, int bullets, int ticks) {
+  float const arenaW = 64 * TILE_SIZE, arenaH = 32 * TILE_SIZE;
+  float const dt = 1.0f / DEFAULT_TICK_RATE;
+  Rng rng;
+  seedRng(rng, 3);
+
+  std::vector<Player> players(playerCount);
+  for (Player &pl : players) {
+    pl.x = randomFloat(rng) * arenaW;
+    pl.y = randomFloat(rng) * arenaH;
+    pl.w = PLAYER_W;
+    pl.h = PLAYER_H;
+    setFlag(pl.status_flags, ALIVE);
+  }
+  std::vector<Rectangle> rects(bullets);
+  std::vector<Direction> moves(bullets);
+  for (int i = 0; i < bullets; i++) {
+    rects[i] = {randomFloat(rng) * arenaW, randomFloat(rng) * arenaH, 8, 8};
+    moves[i] = randomDirection(rng);
+    moves[i].dx *= dt;
+    moves[i].dy *= dt;
+  }
+
+  long linearHits = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < ticks; t++) {
+    for (int i = 0; i < bullets; i++) {
+      linearHits += linearTarget(rects[i], moves[i].dx, moves[i].dy, players);
+    }
+  }
+  double linearSeconds = secondsSince(start);
+
+  SpatialHash grid;
+  long hashedHits = 0;
+  start = std::chrono::steady_clock::now();
+  for (int t = 0; t < ticks; t++) {
+    buildPlayerHash(grid, players);
+    for (int i = 0; i < bullets; i++) {
+      hashedHits += hashedTarget(rects[i], moves[i].dx, moves[i].dy, players, grid);
+    }
+  }
+  double hashedSeconds = secondsSince(start);
+
+  printf("  %3d players %5d bullets  linear %9.2f us/tick   hashed %9.2f us/tick   %.2fx%s\n",
+         playerCount, bullets,
+         linearSeconds * 1e6 / ticks, hashedSeconds * 1e6 / ticks,
+         linearSeconds / hashedSeconds,
+         linearHits == hashedHits ? "" : "   TARGETS DIFFER");
+}
+
+int main(int argc, char **argv) {
+  int ticks = 2000;
+  if (argc > 2 && !strcmp(argv[1], "--ticks")) ticks = atoi(argv[2]);
+
+  SetTraceLogLevel(LOG_WARNING);
+
+  printf("projectiles (legacy AoS + vector trails vs SoA pool + ring trails), %d ticks\n", ticks);
+  for (int population : {16, 128, 512, 2048}) {
+    benchProjectiles(population, ticks);
+  }
+
+  printf("map collision queries on a 1024x1024 map (vector rows vs bit rows), %d queries\n",
+         ticks * 500);
+  benchMapQueries(ticks * 500);
+
+  printf("bullet vs player queries (every player vs spatial hash), %d ticks\n", ticks);
+  for (int playerCount : {2, 4, 8, 16}) {
+    for (int bullets : {128, 512, 2048}) {
+      benchEntityQueries(playerCount, bullets, ticks);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,353 @@
+#pragma once
+
+#include "game.h"
+
+#include <arpa/inet.h>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Rollback netcode for two peers. Each side simulates immediately with a
+// prediction of the remote input (its last confirmed input) and, when the
+// real input arrives and differs, restores the snapshot taken before that
+// tick and re-simulates up to the present. Every packet carries a hash of
+// the sender's weapon table, and neither side simulates until it has seen
+// the peer's and found it equal to its own.
+
+int const MAX_ROLLBACK = 8;       // ticks we may run ahead of confirmed input
+int const INPUT_WINDOW = 128;     // ring size for per-tick input history
+int const MAX_PACKET_INPUTS = 64; // redundant inputs resent per packet
+int const MAX_PACKET_SIZE = 512;
+int const CHECKSUM_INTERVAL = 30; // ticks between desync checks
+int const CHECKSUM_HISTORY = 16;
+
+uint32_t const NET_PACKET_MAGIC = 0x504e4454; // "TDNP"
+
+// UDP socket with optional fake latency, jitter and packet loss applied to
+// outgoing packets, for testing over localhost.
+struct UdpTransport {
+    int socket = -1;
+    sockaddr_in peer = {};
+
+    float latencyMs = 0.0f;
+    float jitterMs = 0.0f;
+    float lossRate = 0.0f;
+    Rng rng;
+
+    struct Delayed {
+        double deliverAt;
+        int size;
+        uint8_t data[MAX_PACKET_SIZE];
+    };
+    std::vector<Delayed> outbox;
+
+    int sent = 0;
+    int dropped = 0;
+    int received = 0;
+};
+
+bool openTransport(UdpTransport &t, int localPort, char const *peerHost, int peerPort) {
+    t.socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (t.socket < 0) {
+        TraceLog(LOG_ERROR, "Failed to create UDP socket");
+        return false;
+    }
+    fcntl(t.socket, F_SETFL, fcntl(t.socket, F_GETFL, 0) | O_NONBLOCK);
+
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons((uint16_t)localPort);
+    if (bind(t.socket, (sockaddr *)&local, sizeof(local)) < 0) {
+        TraceLog(LOG_ERROR, "Failed to bind UDP port %d", localPort);
+        close(t.socket);
+        t.socket = -1;
+        return false;
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo *result = nullptr;
+    if (getaddrinfo(peerHost, nullptr, &hints, &result) != 0 || !result) {
+        TraceLog(LOG_ERROR, "Failed to resolve peer host: %s", peerHost);
+        close(t.socket);
+        t.socket = -1;
+        return false;
+    }
+    t.peer = *(sockaddr_in *)result->ai_addr;
+    t.peer.sin_port = htons((uint16_t)peerPort);
+    freeaddrinfo(result);
+
+    t.outbox.reserve(256);
+    return true;
+}
+
+void closeTransport(UdpTransport &t) {
+    if (t.socket >= 0) close(t.socket);
+    t.socket = -1;
+    t.outbox.clear();
+}
+
+// Hands due packets to the socket. Call once per frame.
+void flushTransport(UdpTransport &t, double nowMs) {
+    for (size_t i = 0; i < t.outbox.size();) {
+        UdpTransport::Delayed &d = t.outbox[i];
+        if (d.deliverAt <= nowMs) {
+            sendto(t.socket, d.data, d.size, 0, (sockaddr *)&t.peer, sizeof(t.peer));
+            t.outbox[i] = t.outbox.back();
+            t.outbox.pop_back();
+        } else {
+            i++;
+        }
+    }
+}
+
+void sendPacket(UdpTransport &t, uint8_t const *data, int size, double nowMs) {
+    t.sent++;
+    if (t.lossRate > 0.0f && randomFloat(t.rng) < t.lossRate) {
+        t.dropped++;
+        return;
+    }
+    UdpTransport::Delayed d;
+    d.deliverAt = nowMs + t.latencyMs + t.jitterMs * randomFloat(t.rng);
+    d.size = size;
+    memcpy(d.data, data, size);
+    t.outbox.push_back(d);
+    flushTransport(t, nowMs);
+}
+
+// Returns the packet size, or 0 when nothing is waiting.
+int receivePacket(UdpTransport &t, uint8_t *data, int capacity) {
+    sockaddr_in from = {};
+    socklen_t fromLen = sizeof(from);
+    ssize_t n = recvfrom(t.socket, data, capacity, 0, (sockaddr *)&from, &fromLen);
+    if (n <= 0) return 0;
+    if (from.sin_port != t.peer.sin_port) return 0;
+    t.received++;
+    return (int)n;
+}
+
+struct RollbackSession {
+    World *world = nullptr;
+    UdpTransport *transport = nullptr;
+    int localPlayer = 0;
+    int remotePlayer = 1;
+    int inputDelay = 2;
+    float dt = 1.0f / DEFAULT_TICK_RATE;
+
+    uint64_t weaponsHash = 0;
+    bool peerVerified = false;    // peer sent a matching weapons hash
+    bool weaponsMismatch = false; // peer plays with other weapons; never starts
+
+    uint32_t tick = 0;            // next tick to simulate
+    uint32_t remoteConfirmed = 0; // remote input known for all ticks below
+    uint32_t peerAck = 0;         // peer has our input for all ticks below
+    uint32_t rollbackFrom = UINT32_MAX;
+
+    uint16_t localInputs[INPUT_WINDOW] = {};
+    uint16_t remoteInputs[INPUT_WINDOW] = {};
+    uint16_t usedRemote[INPUT_WINDOW] = {}; // what we simulated each tick with
+
+    // snapshots[t % (MAX_ROLLBACK + 1)] is the state before tick t.
+    World snapshots[MAX_ROLLBACK + 1];
+
+    uint32_t checksumTicks[CHECKSUM_HISTORY] = {};
+    uint64_t checksums[CHECKSUM_HISTORY] = {};
+    uint32_t nextChecksumTick = CHECKSUM_INTERVAL;
+    uint32_t sentChecksumTick = 0;
+    uint64_t sentChecksum = 0;
+    uint32_t comparedChecksumTick = 0;
+
+    int rollbacks = 0;
+    int resimulatedTicks = 0;
+    int maxResimulated = 0; // most ticks re-run in a single advance
+    int lastResimulated = 0;
+    int stalls = 0;
+    int checksumsCompared = 0;
+    int desyncs = 0;
+};
+
+void initSession(RollbackSession &s, World &world, UdpTransport &transport,
+                 int localPlayer, float dt, int inputDelay = 2) {
+    s.world = &world;
+    s.transport = &transport;
+    s.localPlayer = localPlayer;
+    s.remotePlayer = 1 - localPlayer;
+    s.dt = dt;
+    s.inputDelay = std::clamp(inputDelay, 0, MAX_ROLLBACK);
+    s.weaponsHash = weaponTableHash(*world.weapons);
+    for (World &snapshot : s.snapshots) {
+        copyWorld(snapshot, world);
+    }
+}
+
+void putU16(uint8_t *&p, uint16_t v) { p[0] = v & 0xff; p[1] = v >> 8; p += 2; }
+void putU32(uint8_t *&p, uint32_t v) { for (int i = 0; i < 4; i++) *p++ = (v >> (8 * i)) & 0xff; }
+void putU64(uint8_t *&p, uint64_t v) { for (int i = 0; i < 8; i++) *p++ = (v >> (8 * i)) & 0xff; }
+
+uint16_t getU16(uint8_t const *&p) { uint16_t v = p[0] | (p[1] << 8); p += 2; return v; }
+uint32_t getU32(uint8_t const *&p) { uint32_t v = 0; for (int i = 0; i < 4; i++) v |= (uint32_t)*p++ << (8 * i); return v; }
+uint64_t getU64(uint8_t const *&p) { uint64_t v = 0; for (int i = 0; i < 8; i++) v |= (uint64_t)*p++ << (8 * i); return v; }
+
+uint16_t remoteInputFor(RollbackSession const &s, uint32_t t) {
+    if (t < s.remoteConfirmed) return s.remoteInputs[t % INPUT_WINDOW];
+    if (s.remoteConfirmed == 0) return 0;
+    return s.remoteInputs[(s.remoteConfirmed - 1) % INPUT_WINDOW];
+}
+
+void recordChecksum(RollbackSession &s, uint32_t t, uint64_t checksum) {
+    int slot = (t / CHECKSUM_INTERVAL) % CHECKSUM_HISTORY;
+    s.checksumTicks[slot] = t;
+    s.checksums[slot] = checksum;
+}
+
+void compareChecksum(RollbackSession &s, uint32_t t, uint64_t checksum) {
+    if (t <= s.comparedChecksumTick) return;
+    int slot = (t / CHECKSUM_INTERVAL) % CHECKSUM_HISTORY;
+    if (s.checksumTicks[slot] != t) return;
+    s.comparedChecksumTick = t;
+    s.checksumsCompared++;
+    if (s.checksums[slot] != checksum) {
+        s.desyncs++;
+        TraceLog(LOG_WARNING, "Desync at tick %u", t);
+    }
+}
+
+// Simulates s.tick, saving the snapshot it starts from.
+void simulateTick(RollbackSession &s) {
+    uint32_t t = s.tick;
+    copyWorld(s.snapshots[t % (MAX_ROLLBACK + 1)], *s.world);
+
+    uint16_t remote = remoteInputFor(s, t);
+    s.usedRemote[t % INPUT_WINDOW] = remote;
+    feedControls(s.world->players[s.localPlayer].controls, s.localInputs[t % INPUT_WINDOW]);
+    feedControls(s.world->players[s.remotePlayer].controls, remote);
+    stepWorld(*s.world, s.dt);
+    s.tick++;
+}
+
+void handlePacket(RollbackSession &s, uint8_t const *data, int size) {
+    if (size < 4 + 8 + 4 + 1 + 4 + 4 + 8) return;
+    uint8_t const *p = data;
+    if (getU32(p) != NET_PACKET_MAGIC) return;
+    if (getU64(p) != s.weaponsHash) {
+        if (!s.weaponsMismatch) TraceLog(LOG_ERROR, "Peer has a different weapon table");
+        s.weaponsMismatch = true;
+        return;
+    }
+    s.peerVerified = true;
+
+    uint32_t start = getU32(p);
+    int count = *p++;
+    if (size < 4 + 8 + 4 + 1 + count * 2 + 4 + 4 + 8) return;
+
+    for (int i = 0; i < count; i++) {
+        uint32_t t = start + i;
+        uint16_t input = getU16(p);
+        if (t != s.remoteConfirmed) continue;
+
+        s.remoteInputs[t % INPUT_WINDOW] = input;
+        s.remoteConfirmed++;
+        if (t < s.tick && s.usedRemote[t % INPUT_WINDOW] != input) {
+            s.rollbackFrom = std::min(s.rollbackFrom, t);
+        }
+    }
+
+    uint32_t ack = getU32(p);
+    s.peerAck = std::max(s.peerAck, ack);
+
+    uint32_t checksumTick = getU32(p);
+    uint64_t checksum = getU64(p);
+    compareChecksum(s, checksumTick, checksum);
+}
+
+void sendInputs(RollbackSession &s, double nowMs) {
+    uint8_t buffer[MAX_PACKET_SIZE];
+    uint8_t *p = buffer;
+
+    // Everything the peer has not acknowledged yet; advanceSession stalls
+    // before this could exceed MAX_PACKET_INPUTS.
+    uint32_t end = s.tick + s.inputDelay;
+    uint32_t start = std::min(s.peerAck, end);
+    int count = (int)(end - start);
+
+    putU32(p, NET_PACKET_MAGIC);
+    putU64(p, s.weaponsHash);
+    putU32(p, start);
+    *p++ = (uint8_t)count;
+    for (uint32_t t = start; t < end; t++) {
+        putU16(p, s.localInputs[t % INPUT_WINDOW]);
+    }
+    putU32(p, s.remoteConfirmed);
+    putU32(p, s.sentChecksumTick);
+    putU64(p, s.sentChecksum);
+    sendPacket(*s.transport, buffer, (int)(p - buffer), nowMs);
+}
+
+// Publishes the checksum of the newest state that no longer depends on
+// predicted input, so the peer can compare it against its own.
+void updateConfirmedChecksum(RollbackSession &s) {
+    uint32_t confirmed = std::min(s.remoteConfirmed, s.tick);
+    if (s.rollbackFrom != UINT32_MAX || confirmed < s.nextChecksumTick) return;
+
+    uint32_t t = s.nextChecksumTick;
+    uint64_t checksum = (t == s.tick)
+        ? worldChecksum(*s.world)
+        : worldChecksum(s.snapshots[t % (MAX_ROLLBACK + 1)]);
+    recordChecksum(s, t, checksum);
+    s.sentChecksumTick = t;
+    s.sentChecksum = checksum;
+    s.nextChecksumTick += CHECKSUM_INTERVAL;
+}
+
+// One tick of wall-clock time: takes the local input, applies any late
+// remote input by rolling back, and simulates the next tick unless we are
+// too far ahead of the peer. Returns false when the session had to stall
+// or has not started yet.
+bool advanceSession(RollbackSession &s, uint16_t localInput, double nowMs) {
+    uint8_t buffer[MAX_PACKET_SIZE];
+    int size;
+    while ((size = receivePacket(*s.transport, buffer, sizeof(buffer))) > 0) {
+        handlePacket(s, buffer, size);
+    }
+    if (!s.peerVerified) {
+        sendInputs(s, nowMs);
+        flushTransport(*s.transport, nowMs);
+        return false;
+    }
+
+    s.lastResimulated = 0;
+    if (s.rollbackFrom != UINT32_MAX) {
+        uint32_t target = s.tick;
+        s.tick = s.rollbackFrom;
+        copyWorld(*s.world, s.snapshots[s.tick % (MAX_ROLLBACK + 1)]);
+        while (s.tick < target) {
+            simulateTick(s);
+            s.lastResimulated++;
+        }
+        s.rollbackFrom = UINT32_MAX;
+        s.rollbacks++;
+        s.resimulatedTicks += s.lastResimulated;
+        s.maxResimulated = std::max(s.maxResimulated, s.lastResimulated);
+    }
+    updateConfirmedChecksum(s);
+
+    uint32_t inputTick = s.tick + s.inputDelay;
+    bool ahead = s.tick >= s.remoteConfirmed + MAX_ROLLBACK ||
+                 inputTick + 1 > s.peerAck + MAX_PACKET_INPUTS;
+    if (ahead) {
+        s.stalls++;
+    } else {
+        s.localInputs[inputTick % INPUT_WINDOW] = localInput;
+        simulateTick(s);
+        updateConfirmedChecksum(s);
+    }
+
+    sendInputs(s, nowMs);
+    flushTransport(*s.transport, nowMs);
+    return !ahead;
+}
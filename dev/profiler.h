@@ -0,0 +1,219 @@
+#pragma once
+
+#include "raylib.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// Scoped phase timers, recorded per thread. Build with -DPROFILER to record
+// them; otherwise PROFILE_SCOPE and PROFILE_FRAME compile to nothing.
+//
+//   PROFILE_FRAME();               once at the top of every frame
+//   PROFILE_SCOPE("renderLevel");  times the rest of the enclosing block
+//
+// The last PROFILE_FRAMES frames are kept in a ring buffer, which the
+// overlay summarises and exportProfileTrace writes out as Chrome trace-event
+// JSON (load it in chrome://tracing or Perfetto). Names must be string
+// literals, since only the pointer is stored.
+
+#ifdef PROFILER
+
+int const PROFILE_FRAMES = 240;
+int const PROFILE_SCOPES_PER_FRAME = 256;
+
+struct ProfileRecord {
+    const char *name;
+    int depth;
+    int64_t startNs;
+    int64_t endNs;
+};
+
+struct ProfileFrame {
+    int64_t startNs = 0;
+    int64_t endNs = 0;
+    int count = 0;
+    // Scopes that did not fit in the frame.
+    int dropped = 0;
+    std::array<ProfileRecord, PROFILE_SCOPES_PER_FRAME> records;
+};
+
+struct Profiler {
+    std::array<ProfileFrame, PROFILE_FRAMES> frames;
+    // Frames started so far; the one being recorded is frames[(started - 1) % PROFILE_FRAMES].
+    int64_t started = 0;
+    int depth = 0;
+};
+
+Profiler &profiler() {
+    static thread_local Profiler p;
+    return p;
+}
+
+int64_t profileNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ProfileFrame &profileFrame(Profiler &p, int64_t frame) {
+    return p.frames[(size_t)(frame % PROFILE_FRAMES)];
+}
+
+// Closes the frame being recorded and starts the next one.
+void profileBeginFrame() {
+    Profiler &p = profiler();
+    int64_t now = profileNow();
+    if (p.started > 0) profileFrame(p, p.started - 1).endNs = now;
+    ProfileFrame &frame = profileFrame(p, p.started++);
+    frame.startNs = now;
+    frame.endNs = 0;
+    frame.count = 0;
+    frame.dropped = 0;
+    p.depth = 0;
+}
+
+struct ProfileScope {
+    ProfileRecord *record = nullptr;
+
+    explicit ProfileScope(const char *name) {
+        Profiler &p = profiler();
+        if (p.started == 0) return;
+        ProfileFrame &frame = profileFrame(p, p.started - 1);
+        if (frame.count == PROFILE_SCOPES_PER_FRAME) {
+            frame.dropped++;
+            return;
+        }
+        record = &frame.records[frame.count++];
+        record->name = name;
+        record->depth = p.depth++;
+        record->endNs = 0;
+        record->startNs = profileNow();
+    }
+
+    ~ProfileScope() {
+        if (!record) return;
+        record->endNs = profileNow();
+        profiler().depth--;
+    }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FRAME() profileBeginFrame()
+
+// Completed frames in the ring buffer, oldest first.
+int profiledFrames(Profiler const &p) {
+    return (int)std::min<int64_t>(p.started - 1, PROFILE_FRAMES - 1);
+}
+
+struct PhaseTotal {
+    const char *name;
+    int depth;
+    double lastMs;
+    double meanMs;
+};
+
+int const PROFILE_OVERLAY_PHASES = 24;
+
+// Per-name totals for the last completed frame and the mean over the ones
+// before it, in first-seen order.
+int summarizePhases(Profiler &p, std::array<PhaseTotal, PROFILE_OVERLAY_PHASES> &phases) {
+    int count = 0;
+    int frames = profiledFrames(p);
+    for (int f = 0; f < frames; f++) {
+        int64_t index = p.started - 2 - f;
+        ProfileFrame const &frame = profileFrame(p, index);
+        for (int i = 0; i < frame.count; i++) {
+            ProfileRecord const &r = frame.records[i];
+            int slot = 0;
+            while (slot < count && strcmp(phases[slot].name, r.name) != 0) slot++;
+            if (slot == count) {
+                if (count == PROFILE_OVERLAY_PHASES) continue;
+                phases[count++] = {r.name, r.depth, 0.0, 0.0};
+            }
+            double ms = (r.endNs - r.startNs) / 1e6;
+            if (f == 0) phases[slot].lastMs += ms;
+            phases[slot].meanMs += ms / frames;
+        }
+    }
+    return count;
+}
+
+// Per-phase milliseconds (last frame and mean) and a graph of the buffered
+// frame times, with the 60 fps budget drawn across it.
+void drawProfilerOverlay(int x, int y) {
+    Profiler &p = profiler();
+    int frames = profiledFrames(p);
+    if (frames <= 0) return;
+
+    std::array<PhaseTotal, PROFILE_OVERLAY_PHASES> phases;
+    int count = summarizePhases(p, phases);
+    int const lineH = 18;
+    DrawRectangle(x - 6, y - 6, 420, count * lineH + 130, Fade(BLACK, 0.6f));
+    DrawText("phase                     last ms   mean ms", x, y, 16, WHITE);
+    for (int i = 0; i < count; i++) {
+        PhaseTotal const &phase = phases[i];
+        int row = y + (i + 1) * lineH;
+        DrawText(phase.name, x + phase.depth * 12, row, 16, WHITE);
+        DrawText(TextFormat("%7.3f   %7.3f", phase.lastMs, phase.meanMs), x + 230, row, 16, WHITE);
+    }
+
+    int graphY = y + (count + 1) * lineH + 8;
+    int const graphH = 90;
+    float const msPerPixel = 33.3f / graphH;
+    int barW = std::max(1, 400 / PROFILE_FRAMES);
+    for (int f = 0; f < frames; f++) {
+        ProfileFrame const &frame = profileFrame(p, p.started - 1 - frames + f);
+        double ms = (frame.endNs - frame.startNs) / 1e6;
+        int h = std::min(graphH, (int)(ms / msPerPixel));
+        Color color = ms > 16.7 ? RED : (ms > 8.3 ? YELLOW : GREEN);
+        DrawRectangle(x + f * barW, graphY + graphH - h, barW, h, color);
+    }
+    int budgetY = graphY + graphH - (int)(16.7f / msPerPixel);
+    DrawLine(x, budgetY, x + frames * barW, budgetY, WHITE);
+}
+
+// Writes the buffered frames as Chrome trace events, one complete ("X")
+// event per frame and per scope, timestamps in microseconds.
+bool exportProfileTrace(const char *path) {
+    Profiler &p = profiler();
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        TraceLog(LOG_ERROR, "Failed to open trace file: %s", path);
+        return false;
+    }
+    int frames = profiledFrames(p);
+    int64_t origin = frames > 0 ? profileFrame(p, p.started - 1 - frames).startNs : 0;
+    auto us = [origin](int64_t ns) { return (ns - origin) / 1000.0; };
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    auto event = [&](const char *name, int64_t start, int64_t end) {
+        fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                first ? "" : ",\n", name, us(start), (end - start) / 1000.0);
+        first = false;
+    };
+    for (int f = 0; f < frames; f++) {
+        ProfileFrame const &frame = profileFrame(p, p.started - 1 - frames + f);
+        event("frame", frame.startNs, frame.endNs);
+        for (int i = 0; i < frame.count; i++) {
+            ProfileRecord const &r = frame.records[i];
+            if (r.endNs != 0) event(r.name, r.startNs, r.endNs);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    bool ok = fclose(file) == 0;
+    if (ok) TraceLog(LOG_WARNING, "Wrote %d frames of profile trace to %s", frames, path);
+    return ok;
+}
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+
+#endif
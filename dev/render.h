@@ -0,0 +1,526 @@
+#pragma once
+
+#include "game.h"
+#include "rlgl.h"
+
+Texture testDudeTex;
+Texture testBoxBunny; 
+Texture woodBoxTex; 
+Texture dotTex;
+
+Vector2 LerpVec2(Vector2 a, Vector2 b, float t) {
+    return {
+        a.x + (b.x - a.x) * t,
+        a.y + (b.y - a.y) * t
+    };
+}
+
+// World-space rectangle the camera shows and how many draws were submitted or
+// skipped against it this frame.
+struct ViewCull {
+    Rectangle view;
+    int submitted = 0;
+    int culled = 0;
+};
+
+// Visible world rectangle of an unrotated camera drawing into a target of the
+// given size.
+ViewCull beginCull(Camera2D const &camera, float width, float height) {
+    ViewCull cull;
+    cull.view = {
+        camera.target.x - camera.offset.x / camera.zoom,
+        camera.target.y - camera.offset.y / camera.zoom,
+        width / camera.zoom,
+        height / camera.zoom
+    };
+    return cull;
+}
+
+// Counts the draws and returns whether they should be submitted.
+bool inView(ViewCull &cull, Rectangle bounds, int draws = 1) {
+    if (CheckCollisionRecs(cull.view, bounds)) {
+        cull.submitted += draws;
+        return true;
+    }
+    cull.culled += draws;
+    return false;
+}
+
+// Smallest rectangle holding both points, grown by pad on every side.
+Rectangle boundsOf(Vector2 a, Vector2 b, float pad) {
+    float minX = std::min(a.x, b.x), minY = std::min(a.y, b.y);
+    return {minX - pad, minY - pad,
+            std::max(a.x, b.x) - minX + 2 * pad, std::max(a.y, b.y) - minY + 2 * pad};
+}
+
+// Grows the rectangle to also cover a circle of radius pad around the point.
+Rectangle includePoint(Rectangle r, Vector2 point, float pad) {
+    float right = std::max(r.x + r.width, point.x + pad);
+    float bottom = std::max(r.y + r.height, point.y + pad);
+    r.x = std::min(r.x, point.x - pad);
+    r.y = std::min(r.y, point.y - pad);
+    r.width = right - r.x;
+    r.height = bottom - r.y;
+    return r;
+}
+
+// The level is baked into render textures of MAP_CHUNK_TILES square chunks,
+// so it costs one draw per chunk instead of one per tile. Only chunks near
+// the view are kept baked, which keeps texture memory bounded by the view
+// rather than the map. Chunks without solid tiles get no texture.
+int const LEVEL_CHUNK_TILES = MAP_CHUNK_TILES;
+float const LEVEL_CHUNK_PIXELS = (float)(LEVEL_CHUNK_TILES * TILE_SIZE);
+
+// Chunks are baked once within this many pixels of the view, and unloaded
+// once they are more than twice that far away.
+float const LEVEL_STREAM_MARGIN = LEVEL_CHUNK_PIXELS * 0.5f;
+
+// Chunks baked per frame. Visible chunks that are not baked yet are drawn
+// tile by tile until they are.
+int const LEVEL_BAKES_PER_FRAME = 4;
+
+enum ChunkState : uint8_t {
+    CHUNK_UNBAKED,
+    CHUNK_EMPTY,
+    CHUNK_BAKED,
+};
+
+struct LevelCache {
+    uint64_t revision = 0;
+    int chunksWide = 0;
+    int chunksHigh = 0;
+    std::vector<uint8_t> state;
+    std::vector<RenderTexture2D> chunks;
+    // Indices of the chunks with a texture.
+    std::vector<int> resident;
+};
+
+void unloadLevelCache(LevelCache &cache) {
+    for (int index : cache.resident) {
+        UnloadRenderTexture(cache.chunks[index]);
+    }
+    cache = LevelCache();
+}
+
+void resetLevelCache(LevelCache &cache, GameMap const &map) {
+    unloadLevelCache(cache);
+    cache.revision = map.revision;
+    cache.chunksWide = (map.width + LEVEL_CHUNK_TILES - 1) / LEVEL_CHUNK_TILES;
+    cache.chunksHigh = (map.height + LEVEL_CHUNK_TILES - 1) / LEVEL_CHUNK_TILES;
+    cache.state.assign(cache.chunksWide * cache.chunksHigh, CHUNK_UNBAKED);
+    cache.chunks.assign(cache.chunksWide * cache.chunksHigh, RenderTexture2D{});
+}
+
+TileRange chunkTiles(GameMap const &map, int cx, int cy) {
+    TileRange r;
+    r.left = cx * LEVEL_CHUNK_TILES;
+    r.top = cy * LEVEL_CHUNK_TILES;
+    r.right = std::min(r.left + LEVEL_CHUNK_TILES, map.width) - 1;
+    r.bottom = std::min(r.top + LEVEL_CHUNK_TILES, map.height) - 1;
+    return r;
+}
+
+// Chunks overlapping the rectangle, clamped to the cache.
+TileRange chunksOverlapping(LevelCache const &cache, Rectangle rect) {
+    TileRange r;
+    r.left = std::max(0, (int)std::floor(rect.x / LEVEL_CHUNK_PIXELS));
+    r.top = std::max(0, (int)std::floor(rect.y / LEVEL_CHUNK_PIXELS));
+    r.right = std::min(cache.chunksWide - 1, (int)std::floor((rect.x + rect.width) / LEVEL_CHUNK_PIXELS));
+    r.bottom = std::min(cache.chunksHigh - 1, (int)std::floor((rect.y + rect.height) / LEVEL_CHUNK_PIXELS));
+    return r;
+}
+
+Rectangle growRect(Rectangle r, float by) {
+    return {r.x - by, r.y - by, r.width + 2 * by, r.height + 2 * by};
+}
+
+void drawTiles(GameMap const &map, TileRange r, float originX, float originY) {
+    for (int y = r.top; y <= r.bottom; ++y) {
+        for (int x = r.left; x <= r.right; ++x) {
+            if (isSolid(map, x, y)) {
+                DrawTexture(woodBoxTex, (int)originX + x * TILE_SIZE,
+                            (int)originY + y * TILE_SIZE, WHITE);
+            }
+        }
+    }
+}
+
+void bakeChunk(LevelCache &cache, GameMap const &map, int cx, int cy) {
+    int index = cy * cache.chunksWide + cx;
+    TileRange r = chunkTiles(map, cx, cy);
+    if (!anySolidTile(map, r)) {
+        cache.state[index] = CHUNK_EMPTY;
+        return;
+    }
+    RenderTexture2D &chunk = cache.chunks[index];
+    chunk = LoadRenderTexture((r.right - r.left + 1) * TILE_SIZE,
+                              (r.bottom - r.top + 1) * TILE_SIZE);
+    BeginTextureMode(chunk);
+    ClearBackground(BLANK);
+    drawTiles(map, r, (float)(-r.left * TILE_SIZE), (float)(-r.top * TILE_SIZE));
+    EndTextureMode();
+    cache.state[index] = CHUNK_BAKED;
+    cache.resident.push_back(index);
+}
+
+// Bakes up to budget chunks around the view, nearest rows first, and
+// unloads the ones that drifted out of range. Rebuilds from scratch if the
+// cache was made for a different map. Must be called outside
+// BeginTextureMode, since baking renders to the chunk textures.
+void streamLevelCache(LevelCache &cache, GameMap const &map, Rectangle view, int budget) {
+    if (cache.revision != map.revision || cache.state.empty()) resetLevelCache(cache, map);
+
+    Rectangle keep = growRect(view, 2 * LEVEL_STREAM_MARGIN);
+    for (size_t i = 0; i < cache.resident.size();) {
+        int index = cache.resident[i];
+        Rectangle bounds = {(index % cache.chunksWide) * LEVEL_CHUNK_PIXELS,
+                            (index / cache.chunksWide) * LEVEL_CHUNK_PIXELS,
+                            LEVEL_CHUNK_PIXELS, LEVEL_CHUNK_PIXELS};
+        if (CheckCollisionRecs(keep, bounds)) {
+            i++;
+            continue;
+        }
+        UnloadRenderTexture(cache.chunks[index]);
+        cache.chunks[index] = RenderTexture2D{};
+        cache.state[index] = CHUNK_UNBAKED;
+        cache.resident[i] = cache.resident.back();
+        cache.resident.pop_back();
+    }
+
+    // Visible chunks first, then the margin around them.
+    for (float margin : {0.0f, LEVEL_STREAM_MARGIN}) {
+        TileRange r = chunksOverlapping(cache, growRect(view, margin));
+        for (int cy = r.top; cy <= r.bottom && budget > 0; ++cy) {
+            for (int cx = r.left; cx <= r.right && budget > 0; ++cx) {
+                if (cache.state[cy * cache.chunksWide + cx] != CHUNK_UNBAKED) continue;
+                bakeChunk(cache, map, cx, cy);
+                budget--;
+            }
+        }
+    }
+}
+
+// Starts streaming in the map of the coming round around the current view
+// while the round-over screen is up, into a spare cache.
+void prebakeLevelCache(LevelCache &spare, LevelCache const &current, GameMap const &next,
+                       Rectangle view) {
+    if (next.revision == current.revision) return;
+    streamLevelCache(spare, next, view, LEVEL_BAKES_PER_FRAME);
+}
+
+// Streams the cache for this frame's view, first swapping in the spare if it
+// was prebaked for this map.
+void updateLevelCache(LevelCache &cache, GameMap const &map, Rectangle view,
+                      LevelCache *spare = nullptr) {
+    if (cache.revision != map.revision && spare && spare->revision == map.revision) {
+        std::swap(cache, *spare);
+        unloadLevelCache(*spare);
+    }
+    streamLevelCache(cache, map, view, LEVEL_BAKES_PER_FRAME);
+}
+
+void renderLevel(LevelCache const &cache, GameMap const &map, ViewCull &cull) {
+    if (cache.revision != map.revision) return;
+    TileRange r = chunksOverlapping(cache, cull.view);
+    int visited = 0;
+    for (int cy = r.top; cy <= r.bottom; ++cy) {
+        for (int cx = r.left; cx <= r.right; ++cx) {
+            visited++;
+            int index = cy * cache.chunksWide + cx;
+            if (cache.state[index] == CHUNK_EMPTY) continue;
+            Rectangle dst = {cx * LEVEL_CHUNK_PIXELS, cy * LEVEL_CHUNK_PIXELS,
+                             LEVEL_CHUNK_PIXELS, LEVEL_CHUNK_PIXELS};
+            if (!inView(cull, dst)) continue;
+            if (cache.state[index] == CHUNK_UNBAKED) {
+                TileRange tiles = chunkTiles(map, cx, cy);
+                TileRange seen = tilesOverlapping(map, cull.view);
+                tiles = {std::max(tiles.left, seen.left), std::max(tiles.top, seen.top),
+                         std::min(tiles.right, seen.right), std::min(tiles.bottom, seen.bottom)};
+                drawTiles(map, tiles, 0.0f, 0.0f);
+                continue;
+            }
+            RenderTexture2D const &chunk = cache.chunks[index];
+            // Render textures are stored upside down.
+            Rectangle src = {0.0f, 0.0f, (float)chunk.texture.width, -(float)chunk.texture.height};
+            DrawTextureRec(chunk.texture, src, {dst.x, dst.y}, WHITE);
+        }
+    }
+    cull.culled += (int)cache.state.size() - visited;
+}
+
+// Copy of the player placed between its previous and current step, for
+// drawing with the fixed-tick accumulator's leftover fraction.
+Player interpolatePlayer(Player const &player, float alpha) {
+    Player view = player;
+    view.x = player.prev_x + (player.x - player.prev_x) * alpha;
+    view.y = player.prev_y + (player.y - player.prev_y) * alpha;
+    return view;
+}
+
+// gun is the kind of gun the player holds, if any.
+void renderPlayer(Player const &player, GunArchetype const *gun) {
+    Rectangle src = {
+        0.0f, 
+        0.0f, 
+        (float)testBoxBunny.width, 
+        (float)testBoxBunny.height
+    };
+
+    Rectangle dst = {
+        player.x, 
+        player.y, 
+        player.w, 
+        player.h
+    };
+    
+		if (player.facing < 0) {
+        src.width = -src.width;
+    }
+
+    Vector2 origin = {0.0f, 0.0f};
+
+    DrawTexturePro(testBoxBunny, src, dst, origin, 0.0f, WHITE);
+			
+	float shoulderY = player.y + player.h * 0.50;  
+	float shoulderX = (player.facing == 1) 
+    ? player.x + player.w * 0.0f   
+    : player.x + player.w * 1.0f;  
+	
+	float armThickness = player.w * 0.25;        
+	float armLength    = player.h * 0.45f;       
+	
+	if (!gun) {
+	    Rectangle arm = {
+	        shoulderX - armThickness * 0.5f,  
+	        shoulderY,
+	        armThickness,
+	        armLength
+	    };
+	    DrawRectangleRec(arm, WHITE);
+	} else {
+    float gunScale = player.h / 100.0f; 
+    float gunW = gun->w * gunScale;
+    float gunH = gun->h * gunScale;
+
+    float armX, armY;
+    if (player.facing == 1) {
+        armX = shoulderX;
+        armY = shoulderY - armThickness * 0.5f;
+
+        Rectangle arm = {armX, armY, armLength, armThickness};
+        DrawRectangleRec(arm, WHITE);
+
+        float gunX = arm.x + arm.width;
+        float gunY = arm.y + arm.height/2.0f - gunH/2.0f;
+        Rectangle gunRect = {gunX, gunY, gunW, gunH};
+        DrawRectangleRec(gunRect, BLACK);
+
+    } else {
+        armX = shoulderX - armLength;
+        armY = shoulderY - armThickness * 0.5f;
+
+        Rectangle arm = {armX, armY, armLength, armThickness};
+        DrawRectangleRec(arm, WHITE);
+
+        float gunX = arm.x - gunW;
+        float gunY = arm.y + arm.height/2.0f - gunH/2.0f;
+        Rectangle gunRect = {gunX, gunY, gunW, gunH};
+        DrawRectangleRec(gunRect, BLACK);
+    }
+	}
+	if (player.hitTimer > 0.0f) {
+	    DrawRectangle(player.x, player.y, player.w, player.h, Fade(RED, 0.5f));
+	}
+}
+
+
+// Draws the living players. The arm and gun reach up to a player height
+// beyond the body, so the cull bounds are widened by that much.
+void renderPlayers(std::vector<Player> const &players, GunPool const &guns,
+                   WeaponTable const &weapons, float alpha, ViewCull &cull) {
+    for (Player const &player : players) {
+        if (!hasFlag(player.status_flags, ALIVE)) continue;
+        Player view = interpolatePlayer(player, alpha);
+        Rectangle bounds = {view.x - view.h, view.y, view.w + 2 * view.h, view.h};
+        if (!inView(cull, bounds)) continue;
+        Gun const *gun = getItem(guns, player.gun);
+        renderPlayer(view, gun ? &gunArchetype(weapons, *gun) : nullptr);
+    }
+}
+
+
+void renderGuns(GunPool const &guns, WeaponTable const &weapons, ViewCull &cull) {
+  forEachItem(guns, [&](Gun const &gun, Handle) {
+    GunArchetype const &kind = gunArchetype(weapons, gun);
+    if (!gun.picked_up && inView(cull, {gun.x, gun.y, kind.w, kind.h})) {
+      DrawRectangle(gun.x, gun.y, kind.w, kind.h, BLUE);
+    }
+  });
+}
+
+
+void renderPickups(PickupPool const &pickups, ViewCull &cull) {
+    forEachItem(pickups, [&](Pickup const &p, Handle) {
+        if (!p.active) return;
+        if (!inView(cull, boundsOf(p.position, p.position, 8))) return;
+
+        Color c = (p.type == GUN) ? ORANGE : SKYBLUE;
+        DrawCircleV(p.position, 8, c);
+    });
+}
+
+
+// Trail dots and bullets are textured quads written straight into rlgl's
+// vertex batch, so all of them share one draw call per batch buffer instead
+// of costing a triangle fan each. Keep other drawing out of the
+// beginDots/endDots span.
+int const DOT_RESERVE_QUADS = 512;
+
+struct DotBatch {
+    int quads = 0;
+    int flushes = 0;
+    int reserved = 0;
+};
+
+// Makes room for the next DOT_RESERVE_QUADS quads, drawing the batch first
+// if it is too full.
+void reserveDots(DotBatch &batch) {
+    if (rlCheckRenderBatchLimit(4 * DOT_RESERVE_QUADS)) batch.flushes++;
+    batch.reserved = DOT_RESERVE_QUADS;
+    rlSetTexture(dotTex.id);
+    rlBegin(RL_QUADS);
+}
+
+void beginDots(DotBatch &batch) {
+    reserveDots(batch);
+}
+
+void pushDot(DotBatch &batch, Vector2 p, float radius, Color c) {
+    if (batch.reserved == 0) {
+        rlEnd();
+        reserveDots(batch);
+    }
+    batch.reserved--;
+    batch.quads++;
+    rlColor4ub(c.r, c.g, c.b, c.a);
+    rlTexCoord2f(0.0f, 0.0f); rlVertex2f(p.x - radius, p.y - radius);
+    rlTexCoord2f(0.0f, 1.0f); rlVertex2f(p.x - radius, p.y + radius);
+    rlTexCoord2f(1.0f, 1.0f); rlVertex2f(p.x + radius, p.y + radius);
+    rlTexCoord2f(1.0f, 0.0f); rlVertex2f(p.x + radius, p.y - radius);
+}
+
+void endDots() {
+    rlEnd();
+    rlSetTexture(0);
+}
+
+// Draw calls the dots took: one per mid-frame flush plus the final one.
+int dotDrawCalls(DotBatch const &batch) {
+    return batch.quads > 0 ? batch.flushes + 1 : 0;
+}
+
+
+// Bullets fly straight, so the oldest trail point and the bullet itself
+// bound the whole trail.
+void renderProjectiles(ProjectilePool const &p, float t, ViewCull &cull, DotBatch &batch) {
+	for (int i = 0; i < p.count; i++) {
+	    Trail<PROJECTILE_TRAIL> const &trail = p.trail[i];
+	    Vector2 head = LerpVec2({p.prev_x[i], p.prev_y[i]}, {p.x[i], p.y[i]}, t);
+	    Vector2 tail = trail.count > 0 ? trailPoint(trail, 0) : head;
+	    if (!inView(cull, boundsOf(tail, head, 4), trail.count + 1)) continue;
+	    for (int j = 0; j < trail.count; j++) {
+	        float alpha = (j + 1) / (float)trail.count;
+	        pushDot(batch, trailPoint(trail, j), 3, Fade(YELLOW, alpha));
+	    }
+	    pushDot(batch, head, 4, ORANGE);
+	}
+}
+
+
+void renderGrenades(GrenadePool const &grenades, float t, ViewCull &cull,
+                    DotBatch &batch) {
+    forEachItem(grenades, [&](Grenade const &g, Handle) {
+        Vector2 pos = LerpVec2({g.prev_x, g.prev_y}, {g.x, g.y}, t);
+        Rectangle bounds = boundsOf(pos, pos, g.radius);
+        for (int i = 0; i < g.trail.count; i++) {
+            bounds = includePoint(bounds, trailPoint(g.trail, i), 3);
+        }
+        if (!inView(cull, bounds, g.trail.count + 1)) return;
+        for (int i = 0; i < g.trail.count; i++) {
+            float alpha = (i + 1) / (float)g.trail.count;
+            pushDot(batch, trailPoint(g.trail, i), 3, Fade(GREEN, alpha * 0.6f));
+        }
+        pushDot(batch, pos, g.radius, DARKGREEN);
+    });
+}
+
+
+void updateCamera(Camera2D &camera, std::vector<Player> const &players) {
+    Vector2 avgPos = {0, 0};
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+    int aliveCount = 0;
+
+    for (auto &pl : players) {
+        if (!hasFlag(pl.status_flags, ALIVE)) continue;
+        aliveCount++;
+        avgPos.x += pl.x + pl.w * 0.5f;
+        avgPos.y += pl.y + pl.h * 0.5f;
+        minX = std::min(minX, pl.x);
+        minY = std::min(minY, pl.y);
+        maxX = std::max(maxX, pl.x + pl.w);
+        maxY = std::max(maxY, pl.y + pl.h);
+    }
+    if (aliveCount > 0) {
+        avgPos.x /= (float)aliveCount;
+        avgPos.y /= (float)aliveCount;
+
+        camera.target = LerpVec2(camera.target, avgPos, 0.10f);
+
+        float pad = 200.0f;
+        float viewW = (maxX - minX) + pad;
+        float viewH = (maxY - minY) + pad;
+
+        viewW = std::max(viewW, 1.0f);
+        viewH = std::max(viewH, 1.0f);
+
+        float zoomX = (float)RES_W / viewW;
+        float zoomY = (float)RES_H / viewH;
+
+        float const zoom_factor = 0.50f;
+        float desiredZoom = std::min(zoomX, zoomY) * zoom_factor;
+        desiredZoom = std::clamp(desiredZoom, 0.25f, 2.0f); 
+
+        camera.zoom = camera.zoom + (desiredZoom - camera.zoom) * 0.05f;
+    }
+}
+
+
+void renderToScreen(RenderTexture2D renderTarget) {
+  ClearBackground(BLACK);
+
+  float scale = std::min(
+      (float)GetScreenWidth() / RES_W,
+      (float)GetScreenHeight() / RES_H
+  );
+
+  float scaledWidth  = RES_W * scale;
+  float scaledHeight = RES_H * scale;
+  float offsetX = (GetScreenWidth() - scaledWidth) / 2;
+  float offsetY = (GetScreenHeight() - scaledHeight) / 2;
+
+  Rectangle src = {0, 0, (float)renderTarget.texture.width, -(float)renderTarget.texture.height};
+  Rectangle dst = {offsetX, offsetY, scaledWidth, scaledHeight};
+
+  DrawTexturePro(renderTarget.texture, src, dst, {0, 0}, 0.0f, WHITE);
+}
+
+void init_resources(){
+	testDudeTex = LoadTexture("resources/dude75x100.png");
+	testBoxBunny = LoadTexture("resources/boxRabbit40x100.png");
+	woodBoxTex = LoadTexture("resources/woodBox64x64.png");
+
+	Image dot = GenImageColor(32, 32, BLANK);
+	ImageDrawCircle(&dot, 16, 16, 15, WHITE);
+	dotTex = LoadTextureFromImage(dot);
+	UnloadImage(dot);
+}
@@ -0,0 +1,276 @@
+#pragma once
+
+#include "game.h"
+
+#include <cstring>
+
+// Replay files store the match seed, the weapon table it was played with
+// and the per-tick action mask of every player. Identical consecutive ticks
+// are run-length encoded, so long stretches of held input cost a few bytes.
+//
+//   "TDRP"  u16 version  u8 playerCount  u8 reserved
+//   f32 tickRate  u64 seed  u32 tickCount  u64 finalChecksum
+//   u16 mapCount, then per map: u16 length + path bytes
+//   u16 gunCount, then per gun: u8 length + name bytes, f32 w, f32 h,
+//     u32 ammo, f32 fireRate, f32 projectileSpeed, f32 spread, f32 range
+//   grenade: f32 radius, f32 fuse, f32 bounce, f32 throwSpeed,
+//     u32 shrapnel, f32 shrapnelSpeed, f32 shrapnelRange
+//   runs until EOF: varint runLength, playerCount x u16 action mask
+//
+// All integers are little-endian.
+
+uint16_t const REPLAY_VERSION = 2;
+long const REPLAY_TICKCOUNT_OFFSET = 4 + 2 + 1 + 1 + 4 + 8;
+
+struct ReplayWriter {
+    FILE *file = nullptr;
+    int playerCount = 0;
+    uint32_t ticks = 0;
+    std::vector<uint16_t> run;
+    uint32_t runLength = 0;
+};
+
+struct Replay {
+    int playerCount = 0;
+    float tickRate = DEFAULT_TICK_RATE;
+    uint64_t seed = 0;
+    uint32_t tickCount = 0;
+    uint64_t finalChecksum = 0;
+    std::vector<std::string> mapFiles;
+    WeaponsRef weapons;
+    // Kept run-length encoded as in the file, so memory follows the file
+    // size rather than the tick count its header claims.
+    std::vector<uint32_t> runLengths;
+    std::vector<uint16_t> runInputs; // playerCount per run
+};
+
+void writeBytes(FILE *file, uint64_t value, int count) {
+    for (int i = 0; i < count; i++) {
+        fputc((int)((value >> (8 * i)) & 0xff), file);
+    }
+}
+
+bool readBytes(FILE *file, uint64_t &value, int count) {
+    value = 0;
+    for (int i = 0; i < count; i++) {
+        int c = fgetc(file);
+        if (c == EOF) return false;
+        value |= (uint64_t)c << (8 * i);
+    }
+    return true;
+}
+
+void writeVarint(FILE *file, uint32_t value) {
+    while (value >= 0x80) {
+        fputc((int)(value & 0x7f) | 0x80, file);
+        value >>= 7;
+    }
+    fputc((int)value, file);
+}
+
+bool readVarint(FILE *file, uint32_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        int c = fgetc(file);
+        if (c == EOF) return false;
+        value |= (uint32_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) return true;
+    }
+    return false;
+}
+
+uint32_t floatBits(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+float bitsFloat(uint32_t bits) {
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Call right after the match was started with startMatch(world, seed).
+bool beginReplay(ReplayWriter &writer, std::string const &path,
+                 World const &world, float tickRate) {
+    writer = ReplayWriter();
+    writer.file = fopen(path.c_str(), "wb");
+    if (!writer.file) {
+        TraceLog(LOG_ERROR, "Failed to open replay file: %s", path.c_str());
+        return false;
+    }
+    writer.playerCount = (int)world.players.size();
+    writer.run.assign(writer.playerCount, 0);
+
+    fwrite("TDRP", 1, 4, writer.file);
+    writeBytes(writer.file, REPLAY_VERSION, 2);
+    writeBytes(writer.file, (uint64_t)writer.playerCount, 1);
+    writeBytes(writer.file, 0, 1);
+    writeBytes(writer.file, floatBits(tickRate), 4);
+    writeBytes(writer.file, world.match.seed, 8);
+    writeBytes(writer.file, 0, 4); // tick count, patched in endReplay
+    writeBytes(writer.file, 0, 8); // final checksum, patched in endReplay
+
+    std::vector<std::string> const &maps = world.match.mapFiles;
+    writeBytes(writer.file, maps.size(), 2);
+    for (std::string const &map : maps) {
+        writeBytes(writer.file, map.size(), 2);
+        fwrite(map.data(), 1, map.size(), writer.file);
+    }
+
+    WeaponTable const &weapons = *world.weapons;
+    writeBytes(writer.file, weapons.guns.size(), 2);
+    for (GunArchetype const &gun : weapons.guns) {
+        size_t length = strnlen(gun.name, sizeof(gun.name));
+        writeBytes(writer.file, length, 1);
+        fwrite(gun.name, 1, length, writer.file);
+        writeBytes(writer.file, floatBits(gun.w), 4);
+        writeBytes(writer.file, floatBits(gun.h), 4);
+        writeBytes(writer.file, (uint32_t)gun.ammo, 4);
+        writeBytes(writer.file, floatBits(gun.fire_rate), 4);
+        writeBytes(writer.file, floatBits(gun.projectile_speed), 4);
+        writeBytes(writer.file, floatBits(gun.spread), 4);
+        writeBytes(writer.file, floatBits(gun.range), 4);
+    }
+    GrenadeParams const &g = weapons.grenade;
+    writeBytes(writer.file, floatBits(g.radius), 4);
+    writeBytes(writer.file, floatBits(g.fuse), 4);
+    writeBytes(writer.file, floatBits(g.bounce), 4);
+    writeBytes(writer.file, floatBits(g.throw_speed), 4);
+    writeBytes(writer.file, (uint32_t)g.shrapnel, 4);
+    writeBytes(writer.file, floatBits(g.shrapnel_speed), 4);
+    writeBytes(writer.file, floatBits(g.shrapnel_range), 4);
+    return true;
+}
+
+void flushReplayRun(ReplayWriter &writer) {
+    if (writer.runLength == 0) return;
+    writeVarint(writer.file, writer.runLength);
+    for (uint16_t held : writer.run) {
+        writeBytes(writer.file, held, 2);
+    }
+    writer.runLength = 0;
+}
+
+// Call once per tick after input was fed and before stepWorld.
+void recordTick(ReplayWriter &writer, World const &world) {
+    if (!writer.file) return;
+
+    bool same = writer.runLength > 0;
+    for (int i = 0; i < writer.playerCount && same; i++) {
+        same = writer.run[i] == world.players[i].controls.held;
+    }
+    if (!same) {
+        flushReplayRun(writer);
+        for (int i = 0; i < writer.playerCount; i++) {
+            writer.run[i] = world.players[i].controls.held;
+        }
+    }
+    writer.runLength++;
+    writer.ticks++;
+}
+
+void endReplay(ReplayWriter &writer, World const &world) {
+    if (!writer.file) return;
+
+    flushReplayRun(writer);
+    fseek(writer.file, REPLAY_TICKCOUNT_OFFSET, SEEK_SET);
+    writeBytes(writer.file, writer.ticks, 4);
+    writeBytes(writer.file, worldChecksum(world), 8);
+    fclose(writer.file);
+    writer.file = nullptr;
+}
+
+bool loadReplay(std::string const &path, Replay &replay) {
+    replay = Replay();
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        TraceLog(LOG_ERROR, "Failed to open replay file: %s", path.c_str());
+        return false;
+    }
+
+    char magic[4];
+    uint64_t version, playerCount, reserved, tickRate, seed, tickCount, checksum, mapCount;
+    bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, "TDRP", 4) == 0 &&
+              readBytes(file, version, 2) && version == REPLAY_VERSION &&
+              readBytes(file, playerCount, 1) && playerCount > 0 &&
+              readBytes(file, reserved, 1) &&
+              readBytes(file, tickRate, 4) &&
+              readBytes(file, seed, 8) &&
+              readBytes(file, tickCount, 4) &&
+              readBytes(file, checksum, 8) &&
+              readBytes(file, mapCount, 2);
+    if (!ok) {
+        TraceLog(LOG_ERROR, "Invalid replay header: %s", path.c_str());
+        fclose(file);
+        return false;
+    }
+    replay.playerCount = (int)playerCount;
+    replay.tickRate = bitsFloat((uint32_t)tickRate);
+    replay.seed = seed;
+    replay.tickCount = (uint32_t)tickCount;
+    replay.finalChecksum = checksum;
+
+    for (uint64_t i = 0; i < mapCount && ok; i++) {
+        uint64_t length;
+        ok = readBytes(file, length, 2);
+        std::string map(length, '\0');
+        ok = ok && fread(&map[0], 1, length, file) == length;
+        replay.mapFiles.push_back(map);
+    }
+
+    WeaponTable weapons;
+    uint64_t gunCount = 0;
+    ok = ok && readBytes(file, gunCount, 2) && gunCount > 0 && gunCount <= MAX_GUN_ARCHETYPES;
+    for (uint64_t i = 0; i < gunCount && ok; i++) {
+        GunArchetype gun = {};
+        uint64_t length, w, h, ammo, fireRate, speed, spread, range;
+        ok = readBytes(file, length, 1) && length < sizeof(gun.name) &&
+             fread(gun.name, 1, length, file) == length &&
+             readBytes(file, w, 4) && readBytes(file, h, 4) &&
+             readBytes(file, ammo, 4) && readBytes(file, fireRate, 4) &&
+             readBytes(file, speed, 4) && readBytes(file, spread, 4) &&
+             readBytes(file, range, 4);
+        gun.w = bitsFloat((uint32_t)w);
+        gun.h = bitsFloat((uint32_t)h);
+        gun.ammo = (int)(uint32_t)ammo;
+        gun.fire_rate = bitsFloat((uint32_t)fireRate);
+        gun.projectile_speed = bitsFloat((uint32_t)speed);
+        gun.spread = bitsFloat((uint32_t)spread);
+        gun.range = bitsFloat((uint32_t)range);
+        weapons.guns.push_back(gun);
+    }
+    uint64_t radius, fuse, bounce, throwSpeed, shrapnel, shrapnelSpeed, shrapnelRange;
+    ok = ok && readBytes(file, radius, 4) && readBytes(file, fuse, 4) &&
+         readBytes(file, bounce, 4) && readBytes(file, throwSpeed, 4) &&
+         readBytes(file, shrapnel, 4) && shrapnel <= MAX_PROJECTILES &&
+         readBytes(file, shrapnelSpeed, 4) && readBytes(file, shrapnelRange, 4);
+    if (ok) {
+        weapons.grenade = {bitsFloat((uint32_t)radius), bitsFloat((uint32_t)fuse),
+                           bitsFloat((uint32_t)bounce), bitsFloat((uint32_t)throwSpeed),
+                           (int)shrapnel, bitsFloat((uint32_t)shrapnelSpeed),
+                           bitsFloat((uint32_t)shrapnelRange)};
+        replay.weapons = std::make_shared<WeaponTable const>(weapons);
+    }
+
+    uint64_t ticks = 0;
+    uint32_t runLength;
+    while (ok && readVarint(file, runLength)) {
+        for (int i = 0; i < replay.playerCount && ok; i++) {
+            uint64_t held;
+            ok = readBytes(file, held, 2);
+            replay.runInputs.push_back((uint16_t)held);
+        }
+        replay.runLengths.push_back(runLength);
+        ticks += runLength;
+        ok = ok && ticks <= replay.tickCount;
+    }
+    fclose(file);
+
+    if (!ok || ticks != replay.tickCount) {
+        TraceLog(LOG_ERROR, "Truncated replay file: %s", path.c_str());
+        return false;
+    }
+    return true;
+}